@@ -0,0 +1,334 @@
+/*
+ * AllocCount.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Heap allocation counting; with SOKOBLIT_ALLOC_COUNT on the host, every form
+ * of the global operator new (plain, nothrow and aligned) is replaced by one
+ * which counts as it goes, and every delete to match. The count is
+ * shared with the render pool's threads, so it's kept atomic. Once we're
+ * past loading, any update or render call that allocates is reported as it
+ * happens, and a summary of them all is given every few seconds.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstring>
+
+#if defined( SOKOBLIT_ALLOC_COUNT ) && !defined( TARGET_32BLIT_HW )
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#endif
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "AllocCount.hpp"
+
+
+/* Module variables. */
+
+AllocCount g_alloccount;
+
+#ifdef ALLOCCOUNT_ACTIVE
+
+static std::atomic<uint32_t> g_allocations( 0 );
+
+static const char *g_alloc_names[ALLOC_MAX] =
+{
+  "update",
+  "render"
+};
+
+#endif /* ALLOCCOUNT_ACTIVE */
+
+
+/* Functions. */
+
+#ifdef ALLOCCOUNT_ACTIVE
+
+/*
+ * alloc_block - counts an allocation, and hands it over to malloc; or, if an
+ *               alignment beyond malloc's own is asked for, aligned_alloc.
+ *               Returns nullptr if there's nothing left.
+ */
+
+static void *alloc_block( size_t p_size, size_t p_align )
+{
+  g_allocations.fetch_add( 1, std::memory_order_relaxed );
+
+  if ( 0 == p_size )
+  {
+    p_size = 1;
+  }
+  if ( p_align <= alignof( std::max_align_t ) )
+  {
+    return malloc( p_size );
+  }
+
+  /* aligned_alloc wants the size to be a multiple of the alignment. */
+  return aligned_alloc( p_align, ( p_size + p_align - 1 ) & ~( p_align - 1 ) );
+}
+
+
+/*
+ * operator new - the replacements for the global allocator; all they do is
+ *                count, and then hand over to alloc_block. Running out of
+ *                memory in an instrumented build is the end anyway, so the
+ *                throwing forms just abort; the nothrow ones return nullptr.
+ */
+
+void *operator new( size_t p_size )
+{
+  void *l_block = alloc_block( p_size, 0 );
+  if ( nullptr == l_block )
+  {
+    abort();
+  }
+  return l_block;
+}
+
+void *operator new[]( size_t p_size )
+{
+  return operator new( p_size );
+}
+
+void *operator new( size_t p_size, const std::nothrow_t & ) noexcept
+{
+  return alloc_block( p_size, 0 );
+}
+
+void *operator new[]( size_t p_size, const std::nothrow_t & ) noexcept
+{
+  return alloc_block( p_size, 0 );
+}
+
+void *operator new( size_t p_size, std::align_val_t p_align )
+{
+  void *l_block = alloc_block( p_size, (size_t)p_align );
+  if ( nullptr == l_block )
+  {
+    abort();
+  }
+  return l_block;
+}
+
+void *operator new[]( size_t p_size, std::align_val_t p_align )
+{
+  return operator new( p_size, p_align );
+}
+
+void *operator new( size_t p_size, std::align_val_t p_align, const std::nothrow_t & ) noexcept
+{
+  return alloc_block( p_size, (size_t)p_align );
+}
+
+void *operator new[]( size_t p_size, std::align_val_t p_align, const std::nothrow_t & ) noexcept
+{
+  return alloc_block( p_size, (size_t)p_align );
+}
+
+
+/*
+ * operator delete - everything came from malloc or aligned_alloc, so it all
+ *                   goes back through free, whatever the form.
+ */
+
+void operator delete( void *p_block ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete[]( void *p_block ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete( void *p_block, size_t ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete[]( void *p_block, size_t ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete( void *p_block, const std::nothrow_t & ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete[]( void *p_block, const std::nothrow_t & ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete( void *p_block, std::align_val_t ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete[]( void *p_block, std::align_val_t ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete( void *p_block, size_t, std::align_val_t ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete[]( void *p_block, size_t, std::align_val_t ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete( void *p_block, std::align_val_t, const std::nothrow_t & ) noexcept
+{
+  free( p_block );
+}
+
+void operator delete[]( void *p_block, std::align_val_t, const std::nothrow_t & ) noexcept
+{
+  free( p_block );
+}
+
+#endif /* ALLOCCOUNT_ACTIVE */
+
+
+/*
+ * alloc_total - returns how many allocations have been made so far; only
+ *               differences mean anything. Always zero if we're not counting.
+ */
+
+uint32_t alloc_total( void )
+{
+#ifdef ALLOCCOUNT_ACTIVE
+  return g_allocations.load( std::memory_order_relaxed );
+#else
+  return 0;
+#endif /* ALLOCCOUNT_ACTIVE */
+}
+
+
+/*
+ * AllocCount - constructor; nothing counted yet.
+ */
+
+AllocCount::AllocCount( void )
+{
+  memset( c_stats, 0, sizeof( c_stats ) );
+  c_report_time = 0;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * record - adds a call, and the allocations it made, to the phase's totals;
+ *          the first few calls are loading, and are allowed to allocate.
+ */
+
+void AllocCount::record( allocphase_t p_phase, uint32_t p_allocations )
+{
+  allocstats_t *l_stats = &c_stats[p_phase];
+
+  if ( ++l_stats->calls <= ALLOCCOUNT_WARMUP )
+  {
+    return;
+  }
+
+  if ( p_allocations > 0 )
+  {
+    /* Only shout about the first one; the summary covers the rest. */
+#ifdef ALLOCCOUNT_ACTIVE
+    if ( 0 == l_stats->allocating )
+    {
+      blit::debugf( "allocs: %s call %lu made %lu allocations\n", g_alloc_names[p_phase],
+                    (unsigned long)l_stats->calls, (unsigned long)p_allocations );
+    }
+#endif /* ALLOCCOUNT_ACTIVE */
+    l_stats->allocating++;
+    l_stats->allocations += p_allocations;
+    if ( p_allocations > l_stats->worst )
+    {
+      l_stats->worst = p_allocations;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * report - every so often, sums up how each phase has been doing since we
+ *          finished loading.
+ */
+
+void AllocCount::report( uint32_t p_time )
+{
+  if ( ( p_time - c_report_time ) < ALLOCCOUNT_REPORT_MS )
+  {
+    return;
+  }
+  c_report_time = p_time;
+
+#ifdef ALLOCCOUNT_ACTIVE
+  for ( uint8_t l_phase = 0; l_phase < ALLOC_MAX; l_phase++ )
+  {
+    const allocstats_t *l_stats = &c_stats[l_phase];
+    if ( l_stats->calls <= ALLOCCOUNT_WARMUP )
+    {
+      continue;
+    }
+    blit::debugf( "allocs: %-6s %8lu calls, %6lu allocated (%lu allocations, worst %lu)\n",
+                  g_alloc_names[l_phase], (unsigned long)( l_stats->calls - ALLOCCOUNT_WARMUP ),
+                  (unsigned long)l_stats->allocating, (unsigned long)l_stats->allocations,
+                  (unsigned long)l_stats->worst );
+  }
+#endif /* ALLOCCOUNT_ACTIVE */
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * AllocScope - constructor; notes where the count was when we started.
+ */
+
+AllocScope::AllocScope( allocphase_t p_phase )
+{
+  c_phase = p_phase;
+  c_start = alloc_total();
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * ~AllocScope - destructor; records how many allocations were made while we
+ *               were in scope.
+ */
+
+AllocScope::~AllocScope( void )
+{
+  g_alloccount.record( c_phase, alloc_total() - c_start );
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file AllocCount.cpp */
@@ -0,0 +1,84 @@
+/*
+ * AllocCount.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Heap allocation counting, to keep the frame loop off the heap. Everything
+ * long lived goes in the arena, so once we're running neither update nor
+ * render should ever need to allocate; building with SOKOBLIT_ALLOC_COUNT on
+ * the host counts every allocation made during each call, and reports any
+ * that do.
+ *
+ * Without SOKOBLIT_ALLOC_COUNT (or on the device) it all compiles away.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _ALLOCCOUNT_HPP_
+#define   _ALLOCCOUNT_HPP_
+
+#include "32blit.hpp"
+
+#if defined( SOKOBLIT_ALLOC_COUNT ) && !defined( TARGET_32BLIT_HW )
+#define ALLOCCOUNT_ACTIVE
+#endif
+
+#define ALLOCCOUNT_WARMUP     100     /* calls allowed to allocate while loading */
+#define ALLOCCOUNT_REPORT_MS  5000
+
+typedef enum
+{
+  ALLOC_UPDATE,
+  ALLOC_RENDER,
+  ALLOC_MAX
+} allocphase_t;
+
+typedef struct
+{
+  uint32_t        calls;
+  uint32_t        allocating;         /* steady state calls that allocated */
+  uint32_t        allocations;
+  uint32_t        worst;
+} allocstats_t;
+
+class AllocCount
+{
+  private:
+    allocstats_t    c_stats[ALLOC_MAX];
+    uint32_t        c_report_time;
+
+  public:
+                    AllocCount( void );
+    void            record( allocphase_t, uint32_t );
+    void            report( uint32_t );
+};
+
+/* Counts the allocations made between being created and going out of */
+/* scope, and records them against the phase given.                   */
+
+class AllocScope
+{
+  private:
+    allocphase_t    c_phase;
+    uint32_t        c_start;
+
+  public:
+                    AllocScope( allocphase_t );
+                   ~AllocScope( void );
+};
+
+extern AllocCount g_alloccount;
+
+uint32_t    alloc_total( void );
+
+#ifdef ALLOCCOUNT_ACTIVE
+#define ALLOC_SCOPE(p)      AllocScope l_alloc_scope( p )
+#define ALLOC_REPORT(t)     g_alloccount.report( t )
+#else
+#define ALLOC_SCOPE(p)      do {} while( 0 )
+#define ALLOC_REPORT(t)     do {} while( 0 )
+#endif /* ALLOCCOUNT_ACTIVE */
+
+#endif /* _ALLOCCOUNT_HPP_ */
+
+/* End of file AllocCount.hpp */
@@ -0,0 +1,128 @@
+/*
+ * Arena.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The Arena class is a very simple bump allocator, carving all our long-lived
+ * objects out of a single, fixed sized block of memory rather than the heap.
+ * It also keeps track of who has been using what, so we can report on it.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstring>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Arena.hpp"
+#include "Game.hpp"
+#include "Menu.hpp"
+#include "Player.hpp"
+
+
+/* Make sure that everything we know we need will actually fit. */
+
+#define ARENA_NEED_CORE     ( ARENA_ROUND( sizeof( Game ) ) + ARENA_ROUND( sizeof( Menu ) ) )
+#define ARENA_NEED_LEVELS   ( SOKOBLIT_LEVEL_MAX * ARENA_ROUND( sizeof( Player ) ) + ARENA_NEED_PACK )
+
+static_assert( ARENA_NEED_CORE + ARENA_NEED_TILEMAPS + ARENA_NEED_SPRITES +
+               ARENA_NEED_FONTS + ARENA_NEED_LEVELS <= ARENA_BUDGET,
+               "SokoBlit memory budget exceeded - raise ARENA_BUDGET or trim assets" );
+
+
+/* Module variables. */
+
+alignas( ARENA_ALIGN ) static uint8_t g_arena_buffer[ARENA_BUDGET];
+Arena g_arena( g_arena_buffer, ARENA_BUDGET );
+
+static const char *g_arena_names[ARENA_MAX] =
+{
+  "core", "tilemaps", "sprites", "fonts", "levels"
+};
+
+
+/* Functions. */
+
+/*
+ * Arena - constructor, which takes the block of memory we're carving up.
+ */
+
+Arena::Arena( uint8_t *p_buffer, size_t p_size )
+{
+  /* Just remember the buffer, and start from empty. */
+  c_buffer = p_buffer;
+  c_size = p_size;
+  c_used = 0;
+  memset( c_usage, 0, sizeof( c_usage ) );
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * alloc - hands out the next chunk of the arena, charged to the subsystem
+ *         given. Returns nullptr if we've run out; there is no free!
+ */
+
+void *Arena::alloc( size_t p_size, arena_t p_subsystem )
+{
+  size_t l_size = ARENA_ROUND( p_size );
+
+  /* Make sure we have room for this. */
+  if ( ( c_used + l_size ) > c_size )
+  {
+    blit::debugf( "Arena exhausted: %u bytes for %s, %u free\n",
+                  (unsigned)p_size, g_arena_names[p_subsystem], (unsigned)( c_size - c_used ) );
+    return nullptr;
+  }
+
+  /* Hand out the next block, and keep score. */
+  void *l_block = c_buffer + c_used;
+  c_used += l_size;
+  c_usage[p_subsystem] += l_size;
+
+  /* All done. */
+  return l_block;
+}
+
+
+/*
+ * used - returns the number of bytes handed out, in total or per subsystem.
+ */
+
+size_t Arena::used( void )
+{
+  return c_used;
+}
+
+size_t Arena::used( arena_t p_subsystem )
+{
+  return c_usage[p_subsystem];
+}
+
+
+/*
+ * report - writes out a summary of what each subsystem is using.
+ */
+
+void Arena::report( void )
+{
+  blit::debugf( "Memory arena: %u of %u bytes used\n", (unsigned)c_used, (unsigned)c_size );
+  for( uint8_t l_index = 0; l_index < ARENA_MAX; l_index++ )
+  {
+    blit::debugf( "  %-10s %7u\n", g_arena_names[l_index], (unsigned)c_usage[l_index] );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file Arena.cpp */
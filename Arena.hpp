@@ -0,0 +1,118 @@
+/*
+ * Arena.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The Arena class is a very simple bump allocator, carving all our long-lived
+ * objects out of a single, fixed sized block of memory rather than the heap.
+ * It also keeps track of who has been using what, so we can report on it.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _ARENA_HPP_
+#define   _ARENA_HPP_
+
+#include <new>
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Game.hpp"
+#include "Menu.hpp"
+#include "SpriteSheet.hpp"
+#include "ThumbCache.hpp"
+
+/* The overall budget we allow ourselves; if the sizes below add up to more */
+/* than this, the build will fail rather than us running out on device.     */
+
+#define ARENA_BUDGET        ( 192 * 1024 + ARENA_NEED_NATIVE + ARENA_NEED_PACK + ARENA_NEED_THUMBS + \
+                              ARENA_NEED_WINDOWS )
+#define ARENA_ALIGN         8
+#define ARENA_ROUND(s)      ( ( (s) + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 ) )
+
+/* What we expect each subsystem to need; the menu map is 256x256 tiles but */
+/* the game only holds one level, as cells - the rest is read from flash.   */
+/* The images are sized from the assets, and the format each one loads as. */
+
+#define ARENA_PIXEL_BYTES(f) ( ( blit::PixelFormat::RGBA == (f) ) ? 4 : \
+                               ( blit::PixelFormat::RGB == (f) ) ? 3 : 1 )
+#define ARENA_GAME_FORMAT   blit::PixelFormat::P
+#define ARENA_MENU_FORMAT   blit::PixelFormat::RGBA
+#define ARENA_SPLASH_FORMAT blit::PixelFormat::RGBA
+
+#define ARENA_MAP_TILES     ( 256 * 256 )
+#define ARENA_LEVEL_CELLS   ( GAME_CELLS_W * GAME_CELLS_H )
+#define ARENA_LEVEL_WINDOW  ( GAME_WINDOW_W * GAME_WINDOW_H )
+#define ARENA_GAME_SPRITES  ( 128 * 128 * ARENA_PIXEL_BYTES( ARENA_GAME_FORMAT ) )
+#define ARENA_MENU_SPRITES  ( 128 * 128 * ARENA_PIXEL_BYTES( ARENA_MENU_FORMAT ) )
+#define ARENA_MENU_SPLASH   ( 192 * 48 * ARENA_PIXEL_BYTES( ARENA_SPLASH_FORMAT ) )
+
+#define ARENA_NEED_TILEMAPS ( ARENA_ROUND( ARENA_MAP_TILES ) + \
+                              ARENA_ROUND( ARENA_LEVEL_CELLS ) + \
+                              ARENA_ROUND( sizeof( MetatileSet ) ) + \
+                              2 * ARENA_ROUND( sizeof( blit::TileMap ) ) + \
+                              ARENA_NEED_WINDOWS )
+#define ARENA_NEED_SPRITES  ( ARENA_ROUND( ARENA_GAME_SPRITES ) + \
+                              ARENA_ROUND( ARENA_MENU_SPRITES ) + \
+                              ARENA_ROUND( ARENA_MENU_SPLASH ) + \
+                              2 * ARENA_ROUND( sizeof( SpriteSheet ) ) + \
+                              ARENA_NEED_NATIVE + ARENA_NEED_THUMBS )
+#define ARENA_NEED_FONTS    ( ARENA_ROUND( sizeof( blit::Font ) ) )
+
+/* The menu has a window for each changed level, plus the shared one. */
+
+#define ARENA_NEED_WINDOWS  ( ( MENU_WINDOWS + 1 ) * ( ARENA_ROUND( ARENA_LEVEL_WINDOW ) + \
+                                                   ARENA_ROUND( sizeof( blit::TileMap ) ) ) )
+
+/* An external level pack needs its index, if there is one. */
+
+#define ARENA_NEED_PACK     ( ARENA_ROUND( sizeof( LevelPack ) ) + \
+                              ARENA_ROUND( LEVELPACK_MAX_LEVELS * sizeof( uint32_t ) ) )
+
+/* And browsing it needs room for the thumbnail cache. */
+
+#define ARENA_NEED_THUMBS   ( ARENA_ROUND( sizeof( ThumbCache ) ) + \
+                              THUMB_SLOTS * ( ARENA_ROUND( THUMB_W * THUMB_H ) + \
+                                              ARENA_ROUND( sizeof( blit::Surface ) ) ) )
+
+/* Native sheets need room for their converted copy, too. */
+
+#ifdef SOKOBLIT_NATIVE_SHEETS
+#define ARENA_NEED_NATIVE   ( ARENA_ROUND( SHEET_NATIVE_BYTES( 128, 128 ) ) + \
+                              ARENA_ROUND( SHEET_NATIVE_BYTES( 192, 48 ) ) )
+#else
+#define ARENA_NEED_NATIVE   0
+#endif /* SOKOBLIT_NATIVE_SHEETS */
+
+typedef enum
+{
+  ARENA_CORE,
+  ARENA_TILEMAPS,
+  ARENA_SPRITES,
+  ARENA_FONTS,
+  ARENA_LEVELS,
+  ARENA_MAX
+} arena_t;
+
+class Arena
+{
+  private:
+    uint8_t        *c_buffer;
+    size_t          c_size;
+    size_t          c_used;
+    size_t          c_usage[ARENA_MAX];
+
+  public:
+                    Arena( uint8_t *, size_t );
+    void           *alloc( size_t, arena_t );
+    size_t          used( void );
+    size_t          used( arena_t );
+    void            report( void );
+};
+
+extern Arena g_arena;
+
+#endif /* _ARENA_HPP_ */
+
+/* End of file Arena.hpp */
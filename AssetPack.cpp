@@ -0,0 +1,217 @@
+/*
+ * AssetPack.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The AssetPack lets the Linux build pick up its sprites, fonts and maps from
+ * an external pack file, so that tweaking a map doesn't mean a full rebuild.
+ * The whole file is memory mapped read only and assets are handed out as
+ * pointers straight into it, so it stays mapped for as long as we run.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstring>
+
+#if defined( __linux__ ) && !defined( TARGET_32BLIT_HW )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "AssetPack.hpp"
+
+
+/* Module variables. */
+
+AssetPack g_assets;
+
+
+/* Functions. */
+
+/*
+ * AssetPack - constructor; nothing is opened yet, so everything falls back.
+ */
+
+AssetPack::AssetPack( void )
+{
+  c_map = nullptr;
+  c_size = 0;
+  c_entries = nullptr;
+  c_count = 0;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * ~AssetPack - destructor, lets go of the file.
+ */
+
+AssetPack::~AssetPack( void )
+{
+  close();
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * open - maps in the pack file given, and checks that its directory makes
+ *        sense. Returns false (leaving the built in assets in use) if there
+ *        is no such file, or it isn't a pack we understand.
+ */
+
+bool AssetPack::open( const char *p_filename )
+{
+#ifdef ASSETPACK_MMAP
+  const packheader_t *l_header;
+
+  /* Only ever one pack at a time. */
+  close();
+
+  int l_fd = ::open( p_filename, O_RDONLY );
+  if ( l_fd < 0 )
+  {
+    return false;
+  }
+  struct stat l_stat;
+  if ( ( fstat( l_fd, &l_stat ) < 0 ) || ( (size_t)l_stat.st_size < sizeof( packheader_t ) ) )
+  {
+    ::close( l_fd );
+    return false;
+  }
+  c_size = l_stat.st_size;
+  void *l_map = mmap( nullptr, c_size, PROT_READ, MAP_PRIVATE, l_fd, 0 );
+  ::close( l_fd );
+  if ( MAP_FAILED == l_map )
+  {
+    c_size = 0;
+    return false;
+  }
+  c_map = (const uint8_t *)l_map;
+
+  /* Check the header, and that the directory fits in the file. */
+  l_header = (const packheader_t *)c_map;
+  if ( ( 0 != memcmp( l_header->magic, ASSETPACK_MAGIC, sizeof( l_header->magic ) ) ) ||
+       ( ASSETPACK_VERSION != l_header->version ) ||
+       ( l_header->count > ( c_size - sizeof( packheader_t ) ) / sizeof( packentry_t ) ) )
+  {
+    blit::debugf( "Asset pack %s is not a version %u pack\n", p_filename, ASSETPACK_VERSION );
+    close();
+    return false;
+  }
+  c_entries = (const packentry_t *)( c_map + sizeof( packheader_t ) );
+
+  /* And that every asset in it does, too. */
+  for ( uint32_t l_index = 0; l_index < l_header->count; l_index++ )
+  {
+    if ( ( c_entries[l_index].offset > c_size ) ||
+         ( c_entries[l_index].length > c_size - c_entries[l_index].offset ) ||
+         ( 0 != ( c_entries[l_index].offset & 0x03 ) ) )
+    {
+      blit::debugf( "Asset pack %s is damaged\n", p_filename );
+      close();
+      return false;
+    }
+  }
+  c_count = l_header->count;
+
+  /* All done. */
+  blit::debugf( "Asset pack: %u assets from %s\n", (unsigned)c_count, p_filename );
+  return true;
+#else
+  /* Only the Linux build can map files in; everything else is built in. */
+  return false;
+#endif /* ASSETPACK_MMAP */
+}
+
+
+/*
+ * close - unmaps the pack, if there is one; only safe if nothing that came
+ *         out of it is still in use.
+ */
+
+void AssetPack::close( void )
+{
+#ifdef ASSETPACK_MMAP
+  if ( nullptr != c_map )
+  {
+    munmap( (void *)c_map, c_size );
+  }
+#endif /* ASSETPACK_MMAP */
+  c_map = nullptr;
+  c_size = 0;
+  c_entries = nullptr;
+  c_count = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * find - looks for the named asset in the pack, and returns a pointer to it
+ *        (and its length, if asked) - or the built in fallback given, if
+ *        the pack doesn't have it.
+ */
+
+const uint8_t *AssetPack::find( const char *p_name, const uint8_t *p_fallback,
+                                uint32_t p_fallback_length, uint32_t *p_length )
+{
+  for ( uint32_t l_index = 0; l_index < c_count; l_index++ )
+  {
+    if ( 0 == strncmp( c_entries[l_index].name, p_name, ASSETPACK_NAME_LEN ) )
+    {
+      if ( nullptr != p_length )
+      {
+        *p_length = c_entries[l_index].length;
+      }
+      return c_map + c_entries[l_index].offset;
+    }
+  }
+
+  /* Not in the pack, so it's the one we were built with. */
+  if ( nullptr != p_length )
+  {
+    *p_length = p_fallback_length;
+  }
+  return p_fallback;
+}
+
+
+/*
+ * surface - loads the named image into the buffer given, from the pack if we
+ *           can; if the pack's copy won't load (or won't fit) we say so, and
+ *           use the built in one instead.
+ */
+
+blit::Surface *AssetPack::surface( const char *p_name, const uint8_t *p_fallback,
+                                   uint32_t p_fallback_length, uint8_t *p_buffer, size_t p_size )
+{
+  const uint8_t *l_image = find( p_name, p_fallback, p_fallback_length );
+  blit::Surface *l_surface = blit::Surface::load( l_image, p_buffer, p_size );
+
+  if ( ( nullptr == l_surface ) && ( l_image != p_fallback ) )
+  {
+    blit::debugf( "Asset pack image %s failed to load, using the built in one\n", p_name );
+    l_surface = blit::Surface::load( p_fallback, p_buffer, p_size );
+  }
+
+  /* All done. */
+  return l_surface;
+}
+
+
+/* End of file AssetPack.cpp */
@@ -0,0 +1,73 @@
+/*
+ * AssetPack.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The AssetPack lets the Linux build pick up its sprites, fonts and maps from
+ * an external pack file (built by tools/mkpack.py) instead of the copies that
+ * are compiled in. The pack is memory mapped and never copied; anything it
+ * doesn't have, or any platform without mmap, just gets the built in asset.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _ASSETPACK_HPP_
+#define   _ASSETPACK_HPP_
+
+#include "32blit.hpp"
+
+#define ASSETPACK_FILE      "sokoblit.pak"
+#define ASSETPACK_ENV       "SOKOBLIT_PACK"   /* overrides the file name */
+#define ASSETPACK_MAGIC     "SBPK"
+#define ASSETPACK_VERSION   1
+#define ASSETPACK_NAME_LEN  24
+
+#if defined( __linux__ ) && !defined( TARGET_32BLIT_HW )
+#define ASSETPACK_MMAP
+#endif
+
+/* The pack starts with a header, followed by one entry for each asset; the */
+/* offsets are from the start of the file, and are all four byte aligned.  */
+
+typedef struct
+{
+  char            magic[4];
+  uint32_t        version;
+  uint32_t        count;
+} packheader_t;
+
+typedef struct
+{
+  char            name[ASSETPACK_NAME_LEN];
+  uint32_t        offset;
+  uint32_t        length;
+} packentry_t;
+
+class AssetPack
+{
+  private:
+    const uint8_t      *c_map;
+    uint32_t            c_size;
+    const packentry_t  *c_entries;
+    uint32_t            c_count;
+
+  public:
+                        AssetPack( void );
+                       ~AssetPack( void );
+    bool                open( const char * );
+    void                close( void );
+    const uint8_t      *find( const char *, const uint8_t *, uint32_t, uint32_t * = nullptr );
+    blit::Surface      *surface( const char *, const uint8_t *, uint32_t, uint8_t *, size_t );
+};
+
+extern AssetPack g_assets;
+
+/* Looks up one of the compiled in assets by name, falling back to it. */
+
+#define ASSET( name )       g_assets.find( #name, name, name##_length )
+#define ASSET_SURFACE( name, buffer, size ) \
+                            g_assets.surface( #name, name, name##_length, buffer, size )
+
+#endif /* _ASSETPACK_HPP_ */
+
+/* End of file AssetPack.hpp */
@@ -0,0 +1,265 @@
+/*
+ * Attract.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The attract mode; if the menu is left alone for long enough, we zoom into
+ * a level and play through a stored solution, feeding the moves through the
+ * Game and Player just as if they'd come from the pad. Any input at all
+ * stops it, and once a demo is over the level is put back as it was.
+ *
+ * Every demo ends with a check that the level really was solved, so leaving
+ * it running (or building with SOKOBLIT_SOAK, which starts each demo as the
+ * last one ends) makes a soak test of the whole move and render path.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Attract.hpp"
+#include "Tween.hpp"
+
+
+/* Module variables. */
+
+Attract g_attract;
+
+/* The solutions themselves; these don't need to be the shortest, just to */
+/* get there. Only the packed bytes end up in the binary.                 */
+
+constexpr auto g_solution_1 = attract_pack(
+  "ullluuulullddulldddrrrrrrrrrrrlllllllllllulldrrrrrrrrrrrrurdrllllllluuul"
+  "ullddduulldddrrrrrrrrrrrlllllluuullulddduulldddrrrrrrrrrrdrrlluurrdulldd"
+  "rulllllluuulluuurddluulddddduulldddrrrrrrrrrrllllluuullulddduulldddrrrrl"
+  "lddrrrruurrrrrlllllddlllluurrrrrrrrurrllddrulur" );
+constexpr auto g_solution_2 = attract_pack(
+  "rdrrdddrruululdururuulullllldduurrrrrurrdldddldlllulllllldluuuddrrrrrddd"
+  "dlllurrdruuuurrdrrdrrddllllulldllurdruuuddrrdrrulllrdrrrrullruuldullulll"
+  "llldluudrrrrrrrdrrruruulddddrddllllulldllurdruuuddrrdrrulllrdrrrrullruul"
+  "dullullllldluuuddrrrrrrdrrruuuruulddddddrddllllulldllurdruuuddrrdrrullll"
+  "dllurdruudrrdrrrrulllllrrrruuldrdluullulllllluldrrrrrrrdrrdddllulluudddl"
+  "lurdruudrrdrrulllrrruuldulullllldluudrrrrrrdrdrddllulluudddllurdruudrrdr"
+  "rulllrruulullllllrrrrrrdrddllluudddllurdruudrrruulullllldluruldrrrrrrdrd"
+  "dllluuddrrruulullllluldrrrrrrdrrruuuullllldduurrdluldurrrrrddddlllulllll"
+  "rrrrrdrrruuuullldllduurrrrrddddlllulllldlurul" );
+
+static_assert( ( g_solution_1.moves > 0 ) && ( g_solution_2.moves > 0 ),
+               "attract solutions may only contain the moves d, l, u and r" );
+
+static const attractdemo_t g_demos[] =
+{
+  { 1, g_solution_1.moves, g_solution_1.packed },
+  { 2, g_solution_2.moves, g_solution_2.packed }
+};
+
+#define ATTRACT_DEMOS       ( sizeof( g_demos ) / sizeof( g_demos[0] ) )
+
+
+/* Functions. */
+
+/*
+ * Attract - constructor; we start out idle, with the clock just started.
+ */
+
+Attract::Attract( void )
+{
+  c_state = ATTRACT_IDLE;
+  c_time = 0;
+  c_idle_time = 0;
+  c_hold_time = 0;
+  c_demo = ATTRACT_DEMOS - 1;
+  c_move = 0;
+  c_level = 1;
+  c_runs = 0;
+  c_failures = 0;
+  c_swallowed = false;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * start - looks for the next demo we can play; we only use levels the player
+ *         hasn't touched, so that putting the level back afterwards doesn't
+ *         throw away any of their progress. Returns true if we've started.
+ */
+
+bool Attract::start( Game *p_game )
+{
+  for ( uint8_t l_try = 0; l_try < ATTRACT_DEMOS; l_try++ )
+  {
+    c_demo = ( c_demo + 1 ) % ATTRACT_DEMOS;
+    if ( p_game->untouched( g_demos[c_demo].level ) )
+    {
+      /* Remember where the menu was, and zoom into the demo level. */
+      c_level = g_level;
+      c_move = 0;
+      c_state = ATTRACT_PLAYING;
+      g_level = g_demos[c_demo].level;
+      g_mode = MODE_TO_GAME;
+      g_tweener.start( &g_zoom, 0, SOKOBLIT_ZOOM_MS, EASE_IN_OUT );
+      return true;
+    }
+  }
+
+  /* Nothing we can play right now; try again after another idle spell. */
+  c_idle_time = c_time;
+  return false;
+}
+
+
+/*
+ * leave - heads back to the menu, from wherever the demo has got to.
+ */
+
+void Attract::leave( void )
+{
+  g_mode = MODE_TO_MENU;
+  g_tweener.start( &g_zoom, 100, SOKOBLIT_ZOOM_MS, EASE_IN_OUT );
+  c_state = ATTRACT_LEAVING;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * update - called every update (with the time in milliseconds) to start,
+ *          stop and tidy up after the demos. Returns true if the input this
+ *          time has been used to stop a demo, and should be ignored.
+ */
+
+bool Attract::update( uint32_t p_time, Game *p_game, Menu *p_menu )
+{
+  c_time = p_time;
+  c_swallowed = false;
+
+  /* Any sign of life resets the idle clock, and stops a demo in its tracks. */
+  if ( ( 0 != blit::buttons.pressed ) ||
+       ( blit::joystick.x < -0.3f ) || ( blit::joystick.x > 0.3f ) ||
+       ( blit::joystick.y < -0.3f ) || ( blit::joystick.y > 0.3f ) )
+  {
+    c_idle_time = p_time;
+    if ( ( ATTRACT_PLAYING == c_state ) || ( ATTRACT_HOLDING == c_state ) )
+    {
+      leave();
+    }
+    c_swallowed = ( ATTRACT_IDLE != c_state );
+    return c_swallowed;
+  }
+
+  switch( c_state )
+  {
+    case ATTRACT_IDLE:
+      /* Only start from a quiet menu, with everything loaded; soak runs */
+      /* don't wait at all, so there's no idle clock to check.           */
+      if ( ( MODE_MENU == g_mode ) && ( p_game->ready() ) && ( !p_menu->browsing() )
+#if ATTRACT_IDLE_MS > 0
+           && ( ( p_time - c_idle_time ) >= ATTRACT_IDLE_MS )
+#endif
+         )
+      {
+        start( p_game );
+      }
+      break;
+
+    case ATTRACT_PLAYING:
+      /* The game asks us for moves, as it's ready for them. */
+      break;
+
+    case ATTRACT_HOLDING:
+      /* Once we've shown it off, check it really was solved. */
+      if ( ( p_time - c_hold_time ) >= ATTRACT_HOLD_MS )
+      {
+        bool l_solved = p_game->solved( g_demos[c_demo].level );
+        c_runs++;
+        if ( !l_solved )
+        {
+          c_failures++;
+        }
+        blit::debugf( "attract: level %u, %u moves, %s (%lu runs, %lu failures)\n",
+                      (unsigned)g_demos[c_demo].level, (unsigned)g_demos[c_demo].moves,
+                      l_solved ? "solved" : "NOT SOLVED",
+                      (unsigned long)c_runs, (unsigned long)c_failures );
+        leave();
+      }
+      break;
+
+    case ATTRACT_LEAVING:
+      /* Once we're back in the menu, put the level back how it was; and */
+      /* the menu too, unless the player has already moved it on.        */
+      if ( MODE_MENU == g_mode )
+      {
+        p_game->restart_level( g_demos[c_demo].level );
+        if ( g_level == g_demos[c_demo].level )
+        {
+          g_level = c_level;
+        }
+        c_idle_time = p_time;
+        c_state = ATTRACT_IDLE;
+      }
+      break;
+  }
+
+  /* All done. */
+  return false;
+}
+
+
+/*
+ * playing - returns true while a demo is feeding moves into the game.
+ */
+
+bool Attract::playing( void )
+{
+  return ATTRACT_PLAYING == c_state;
+}
+
+
+/*
+ * swallowed - returns true if this update's input was used to stop a demo,
+ *             so that nothing else should act on it.
+ */
+
+bool Attract::swallowed( void )
+{
+  return c_swallowed;
+}
+
+
+/*
+ * next_move - unpacks the next move of the demo; once we've run out, the
+ *             level should be solved, so we hold it there for a moment.
+ */
+
+direction_t Attract::next_move( void )
+{
+  const attractdemo_t *l_demo = &g_demos[c_demo];
+
+  if ( ATTRACT_PLAYING != c_state )
+  {
+    return DIR_NONE;
+  }
+
+  if ( c_move >= l_demo->moves )
+  {
+    c_hold_time = c_time;
+    c_state = ATTRACT_HOLDING;
+    return DIR_NONE;
+  }
+
+  uint8_t l_code = ( l_demo->packed[c_move / ATTRACT_PER_BYTE] >> ( ( c_move % ATTRACT_PER_BYTE ) * 2 ) ) & 0x03;
+  c_move++;
+
+  /* All done. */
+  return (direction_t)( l_code + 1 );
+}
+
+
+/* End of file Attract.cpp */
@@ -0,0 +1,122 @@
+/*
+ * Attract.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The attract mode; if the menu is left alone for long enough, we zoom into
+ * a level and play through a stored solution, feeding the moves through the
+ * Game and Player just as if they'd come from the pad. Solutions are written
+ * as move strings, and packed down to two bits a move at compile time.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _ATTRACT_HPP_
+#define   _ATTRACT_HPP_
+
+#include <cstddef>
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Game.hpp"
+#include "Menu.hpp"
+
+/* How long the menu sits idle before we start; soak testing runs the demos */
+/* back to back instead.                                                    */
+
+#ifdef SOKOBLIT_SOAK
+#define ATTRACT_IDLE_MS     0
+#else
+#define ATTRACT_IDLE_MS     30000
+#endif /* SOKOBLIT_SOAK */
+
+#define ATTRACT_HOLD_MS     2000    /* time to admire a solved level */
+#define ATTRACT_PER_BYTE    4       /* moves packed into each byte */
+
+typedef enum
+{
+  ATTRACT_IDLE,
+  ATTRACT_PLAYING,
+  ATTRACT_HOLDING,
+  ATTRACT_LEAVING
+} attractstate_t;
+
+/* A solution, packed; each move is its direction less one, lowest bits first. */
+
+template <size_t N>
+struct attractpack_t
+{
+  uint16_t        moves;
+  uint8_t         packed[( N + ATTRACT_PER_BYTE - 2 ) / ATTRACT_PER_BYTE];
+};
+
+typedef struct
+{
+  uint8_t         level;
+  uint16_t        moves;
+  const uint8_t  *packed;
+} attractdemo_t;
+
+
+/*
+ * attract_pack - packs a move string ('d', 'l', 'u' and 'r', like the usual
+ *                Sokoban notation) at compile time; anything else in it gives
+ *                an empty solution, which the table refuses to build with.
+ */
+
+template <size_t N>
+constexpr attractpack_t<N> attract_pack( const char ( &p_moves )[N] )
+{
+  attractpack_t<N> l_pack = {};
+  uint8_t          l_direction = DIR_NONE;
+
+  for ( size_t l_index = 0; l_index < N - 1; l_index++ )
+  {
+    switch( p_moves[l_index] )
+    {
+      case 'd': l_direction = DIR_DOWN; break;
+      case 'l': l_direction = DIR_LEFT; break;
+      case 'u': l_direction = DIR_UP; break;
+      case 'r': l_direction = DIR_RIGHT; break;
+      default:  return attractpack_t<N>{};
+    }
+    l_pack.packed[l_index / ATTRACT_PER_BYTE] |= ( l_direction - 1 ) << ( ( l_index % ATTRACT_PER_BYTE ) * 2 );
+  }
+
+  /* All done. */
+  l_pack.moves = N - 1;
+  return l_pack;
+}
+
+
+class Attract
+{
+  private:
+    attractstate_t  c_state;
+    uint32_t        c_time;
+    uint32_t        c_idle_time;
+    uint32_t        c_hold_time;
+    uint8_t         c_demo;
+    uint16_t        c_move;
+    uint8_t         c_level;
+    uint32_t        c_runs;
+    uint32_t        c_failures;
+    bool            c_swallowed;
+
+    bool            start( Game * );
+    void            leave( void );
+
+  public:
+                    Attract( void );
+    bool            update( uint32_t, Game *, Menu * );
+    bool            playing( void );
+    bool            swallowed( void );
+    direction_t     next_move( void );
+};
+
+extern Attract g_attract;
+
+#endif /* _ATTRACT_HPP_ */
+
+/* End of file Attract.hpp */
@@ -0,0 +1,252 @@
+/*
+ * Blend.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Constant-alpha blending kernels, used when drawing our own (native format)
+ * images with a fade. There's a plain scalar reference version, and faster
+ * versions for whichever vector instructions the target has to offer; they
+ * must all produce exactly the same results.
+ *
+ * Every kernel works a byte at a time (the channels don't interact), using
+ * out = ( src * w + dst * ( 256 - w ) ) >> 8, where w is the alpha stretched
+ * to 0-256 so that full alpha is an exact copy. Each product fits in 16 bits,
+ * which is what lets the vector versions work on 16 bit lanes.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstring>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ )
+#include <emmintrin.h>
+#elif defined( __ARM_FEATURE_SIMD32 )
+#include <arm_acle.h>
+#endif
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Blend.hpp"
+
+
+/* Functions. */
+
+/*
+ * blend_weight - stretches an 8 bit alpha into the 0-256 weight we blend with.
+ */
+
+static inline uint16_t blend_weight( uint8_t p_alpha )
+{
+  return p_alpha + ( p_alpha >> 7 );
+}
+
+
+/*
+ * blend_span_scalar - the reference kernel; blends the given number of bytes
+ *                     of source into the destination, at a constant alpha.
+ */
+
+void blend_span_scalar( uint8_t *p_dst, const uint8_t *p_src, uint32_t p_bytes, uint8_t p_alpha )
+{
+  uint16_t l_src_weight = blend_weight( p_alpha );
+  uint16_t l_dst_weight = 256 - l_src_weight;
+
+  for ( uint32_t l_index = 0; l_index < p_bytes; l_index++ )
+  {
+    p_dst[l_index] = ( p_src[l_index] * l_src_weight + p_dst[l_index] * l_dst_weight ) >> 8;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+#if defined( __AVX2__ )
+
+/*
+ * blend_span - AVX2 kernel, 32 bytes at a time. Unpacking and packing both
+ *              work within 128 bit lanes, so the byte order comes back out
+ *              exactly as it went in.
+ */
+
+void blend_span( uint8_t *p_dst, const uint8_t *p_src, uint32_t p_bytes, uint8_t p_alpha )
+{
+  const __m256i l_src_weight = _mm256_set1_epi16( blend_weight( p_alpha ) );
+  const __m256i l_dst_weight = _mm256_set1_epi16( 256 - blend_weight( p_alpha ) );
+  const __m256i l_zero = _mm256_setzero_si256();
+  uint32_t      l_index = 0;
+
+  for ( ; ( l_index + 32 ) <= p_bytes; l_index += 32 )
+  {
+    __m256i l_src = _mm256_loadu_si256( (const __m256i *)( p_src + l_index ) );
+    __m256i l_dst = _mm256_loadu_si256( (const __m256i *)( p_dst + l_index ) );
+
+    __m256i l_low = _mm256_add_epi16( _mm256_mullo_epi16( _mm256_unpacklo_epi8( l_src, l_zero ), l_src_weight ),
+                                      _mm256_mullo_epi16( _mm256_unpacklo_epi8( l_dst, l_zero ), l_dst_weight ) );
+    __m256i l_high = _mm256_add_epi16( _mm256_mullo_epi16( _mm256_unpackhi_epi8( l_src, l_zero ), l_src_weight ),
+                                       _mm256_mullo_epi16( _mm256_unpackhi_epi8( l_dst, l_zero ), l_dst_weight ) );
+
+    _mm256_storeu_si256( (__m256i *)( p_dst + l_index ),
+                         _mm256_packus_epi16( _mm256_srli_epi16( l_low, 8 ), _mm256_srli_epi16( l_high, 8 ) ) );
+  }
+
+  /* Mop up whatever is left over. */
+  blend_span_scalar( p_dst + l_index, p_src + l_index, p_bytes - l_index, p_alpha );
+  return;
+}
+
+const char *blend_kernel( void )
+{
+  return "avx2";
+}
+
+#elif defined( __SSE2__ )
+
+/*
+ * blend_span - SSE2 kernel, 16 bytes at a time.
+ */
+
+void blend_span( uint8_t *p_dst, const uint8_t *p_src, uint32_t p_bytes, uint8_t p_alpha )
+{
+  const __m128i l_src_weight = _mm_set1_epi16( blend_weight( p_alpha ) );
+  const __m128i l_dst_weight = _mm_set1_epi16( 256 - blend_weight( p_alpha ) );
+  const __m128i l_zero = _mm_setzero_si128();
+  uint32_t      l_index = 0;
+
+  for ( ; ( l_index + 16 ) <= p_bytes; l_index += 16 )
+  {
+    __m128i l_src = _mm_loadu_si128( (const __m128i *)( p_src + l_index ) );
+    __m128i l_dst = _mm_loadu_si128( (const __m128i *)( p_dst + l_index ) );
+
+    __m128i l_low = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( l_src, l_zero ), l_src_weight ),
+                                   _mm_mullo_epi16( _mm_unpacklo_epi8( l_dst, l_zero ), l_dst_weight ) );
+    __m128i l_high = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( l_src, l_zero ), l_src_weight ),
+                                    _mm_mullo_epi16( _mm_unpackhi_epi8( l_dst, l_zero ), l_dst_weight ) );
+
+    _mm_storeu_si128( (__m128i *)( p_dst + l_index ),
+                      _mm_packus_epi16( _mm_srli_epi16( l_low, 8 ), _mm_srli_epi16( l_high, 8 ) ) );
+  }
+
+  /* Mop up whatever is left over. */
+  blend_span_scalar( p_dst + l_index, p_src + l_index, p_bytes - l_index, p_alpha );
+  return;
+}
+
+const char *blend_kernel( void )
+{
+  return "sse2";
+}
+
+#else
+
+/*
+ * blend_span - SIMD-within-a-register kernel, 4 bytes at a time; alternate
+ *              bytes are spread into 16 bit lanes so that a single 32 bit
+ *              multiply handles two of them. On the Cortex-M7 the DSP
+ *              extension does the spreading for us in a single instruction.
+ */
+
+void blend_span( uint8_t *p_dst, const uint8_t *p_src, uint32_t p_bytes, uint8_t p_alpha )
+{
+  uint32_t l_src_weight = blend_weight( p_alpha );
+  uint32_t l_dst_weight = 256 - l_src_weight;
+  uint32_t l_index = 0;
+
+  for ( ; ( l_index + 4 ) <= p_bytes; l_index += 4 )
+  {
+    uint32_t l_src, l_dst, l_out;
+    memcpy( &l_src, p_src + l_index, 4 );
+    memcpy( &l_dst, p_dst + l_index, 4 );
+
+#if defined( __ARM_FEATURE_SIMD32 )
+    uint32_t l_src_even = __uxtb16( l_src );
+    uint32_t l_src_odd = __uxtb16( __ror( l_src, 8 ) );
+    uint32_t l_dst_even = __uxtb16( l_dst );
+    uint32_t l_dst_odd = __uxtb16( __ror( l_dst, 8 ) );
+#else
+    uint32_t l_src_even = l_src & 0x00FF00FF;
+    uint32_t l_src_odd = ( l_src >> 8 ) & 0x00FF00FF;
+    uint32_t l_dst_even = l_dst & 0x00FF00FF;
+    uint32_t l_dst_odd = ( l_dst >> 8 ) & 0x00FF00FF;
+#endif
+
+    l_out = ( ( ( l_src_even * l_src_weight + l_dst_even * l_dst_weight ) >> 8 ) & 0x00FF00FF ) |
+            ( ( l_src_odd * l_src_weight + l_dst_odd * l_dst_weight ) & 0xFF00FF00 );
+    memcpy( p_dst + l_index, &l_out, 4 );
+  }
+
+  /* Mop up whatever is left over. */
+  blend_span_scalar( p_dst + l_index, p_src + l_index, p_bytes - l_index, p_alpha );
+  return;
+}
+
+const char *blend_kernel( void )
+{
+#if defined( __ARM_FEATURE_SIMD32 )
+  return "dsp";
+#else
+  return "swar";
+#endif
+}
+
+#endif
+
+
+/*
+ * blend_benchmark - runs the scalar and vector kernels over the same data,
+ *                   checking that they agree and reporting how long each took.
+ *                   Only built in when benchmarks are asked for.
+ */
+
+void blend_benchmark( void )
+{
+#ifdef SOKOBLIT_BENCHMARK
+  /* Splash-sized buffers; that's the biggest thing we blend. */
+  const uint32_t  l_bytes = 192 * 48 * 3;
+  const uint16_t  l_loops = 200;
+  static uint8_t  l_src[l_bytes], l_scalar[l_bytes], l_vector[l_bytes];
+  uint32_t        l_start, l_scalar_us, l_vector_us;
+
+  for ( uint32_t l_index = 0; l_index < l_bytes; l_index++ )
+  {
+    l_src[l_index] = ( l_index * 7 ) & 0xFF;
+    l_scalar[l_index] = l_vector[l_index] = ( l_index * 13 ) & 0xFF;
+  }
+
+  /* Run each kernel the same number of times, over a spread of alphas. */
+  l_start = blit::now_us();
+  for ( uint16_t l_loop = 0; l_loop < l_loops; l_loop++ )
+  {
+    blend_span_scalar( l_scalar, l_src, l_bytes, l_loop & 0xFF );
+  }
+  l_scalar_us = blit::us_diff( l_start, blit::now_us() );
+
+  l_start = blit::now_us();
+  for ( uint16_t l_loop = 0; l_loop < l_loops; l_loop++ )
+  {
+    blend_span( l_vector, l_src, l_bytes, l_loop & 0xFF );
+  }
+  l_vector_us = blit::us_diff( l_start, blit::now_us() );
+
+  /* And report what we found. */
+  blit::debugf( "bench: blend scalar %lu us, %s %lu us (x%lu.%02lu), results %s\n",
+                (unsigned long)l_scalar_us, blend_kernel(), (unsigned long)l_vector_us,
+                (unsigned long)( l_scalar_us / ( l_vector_us ? l_vector_us : 1 ) ),
+                (unsigned long)( ( l_scalar_us * 100 / ( l_vector_us ? l_vector_us : 1 ) ) % 100 ),
+                memcmp( l_scalar, l_vector, l_bytes ) ? "DIFFER" : "match" );
+#endif /* SOKOBLIT_BENCHMARK */
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file Blend.cpp */
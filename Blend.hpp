@@ -0,0 +1,26 @@
+/*
+ * Blend.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Constant-alpha blending kernels, used when drawing our own (native format)
+ * images with a fade. There's a plain scalar reference version, and faster
+ * versions for whichever vector instructions the target has to offer; they
+ * must all produce exactly the same results.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _BLEND_HPP_
+#define   _BLEND_HPP_
+
+#include "32blit.hpp"
+
+void        blend_span_scalar( uint8_t *, const uint8_t *, uint32_t, uint8_t );
+void        blend_span( uint8_t *, const uint8_t *, uint32_t, uint8_t );
+const char *blend_kernel( void );
+void        blend_benchmark( void );
+
+#endif /* _BLEND_HPP_ */
+
+/* End of file Blend.hpp */
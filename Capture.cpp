@@ -0,0 +1,532 @@
+/*
+ * Capture.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Off-screen capture, for checking and timing rendering changes. When built
+ * with SOKOBLIT_CAPTURE on the host, a fixed set of levels and zooms is drawn
+ * into an off-screen surface rather than the window; each frame is written
+ * out as a PNG, compared pixel for pixel against a golden copy, and timed.
+ * The game then exits, with a failure status if anything differed.
+ *
+ * The PNGs are written uncompressed (stored deflate blocks), which keeps the
+ * code here small and means we can read our own goldens back without a PNG
+ * library; anything else is reported rather than guessed at.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#if defined( SOKOBLIT_CAPTURE ) && !defined( TARGET_32BLIT_HW )
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#endif /* SOKOBLIT_CAPTURE */
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "AllocCount.hpp"
+#include "Capture.hpp"
+#include "RenderPool.hpp"
+
+
+/* Functions. */
+
+/*
+ * RenderTarget - constructor; remembers the screen, and swaps in the target.
+ */
+
+RenderTarget::RenderTarget( blit::Surface &p_target ) : c_saved( blit::screen )
+{
+  blit::screen = p_target;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * ~RenderTarget - destructor; puts the real screen back.
+ */
+
+RenderTarget::~RenderTarget( void )
+{
+  blit::screen = c_saved;
+
+  /* All done. */
+  return;
+}
+
+
+#if defined( SOKOBLIT_CAPTURE ) && !defined( TARGET_32BLIT_HW )
+
+/* The frames we capture; a spread of menu, transition and game views. */
+
+typedef struct
+{
+  uimode_t        mode;
+  uint8_t         level;
+  uint8_t         zoom;
+} capture_t;
+
+static const capture_t g_captures[] =
+{
+  { MODE_MENU,     1,  100 },
+  { MODE_MENU,     12, 100 },
+  { MODE_TO_GAME,  7,  60 },
+  { MODE_TO_GAME,  11, 20 },
+  { MODE_GAME,     1,  0 },
+  { MODE_GAME,     12, 0 },
+  { MODE_GAME,     22, 0 }
+};
+
+/* The steady modes that updates are checked in; nothing is drawn. */
+
+static const capture_t g_tick_modes[] =
+{
+  { MODE_MENU,     1,  100 },
+  { MODE_GAME,     1,  0 }
+};
+
+static uint32_t g_crc_table[256];
+
+
+/*
+ * png_crc - the CRC that PNG chunks are checked with.
+ */
+
+static uint32_t png_crc( const uint8_t *p_data, size_t p_length, uint32_t p_crc = 0 )
+{
+  if ( 0 == g_crc_table[1] )
+  {
+    for ( uint32_t l_index = 0; l_index < 256; l_index++ )
+    {
+      uint32_t l_crc = l_index;
+      for ( uint8_t l_bit = 0; l_bit < 8; l_bit++ )
+      {
+        l_crc = ( l_crc & 1 ) ? ( 0xEDB88320 ^ ( l_crc >> 1 ) ) : ( l_crc >> 1 );
+      }
+      g_crc_table[l_index] = l_crc;
+    }
+  }
+
+  p_crc = ~p_crc;
+  for ( size_t l_index = 0; l_index < p_length; l_index++ )
+  {
+    p_crc = g_crc_table[( p_crc ^ p_data[l_index] ) & 0xFF] ^ ( p_crc >> 8 );
+  }
+  return ~p_crc;
+}
+
+
+/*
+ * png_put32 - appends a big-endian 32 bit value.
+ */
+
+static void png_put32( std::vector<uint8_t> &p_out, uint32_t p_value )
+{
+  p_out.push_back( p_value >> 24 );
+  p_out.push_back( p_value >> 16 );
+  p_out.push_back( p_value >> 8 );
+  p_out.push_back( p_value );
+  return;
+}
+
+
+/*
+ * png_get32 - reads a big-endian 32 bit value.
+ */
+
+static uint32_t png_get32( const uint8_t *p_data )
+{
+  return ( (uint32_t)p_data[0] << 24 ) | ( (uint32_t)p_data[1] << 16 ) |
+         ( (uint32_t)p_data[2] << 8 ) | p_data[3];
+}
+
+
+/*
+ * png_chunk - appends a complete chunk, with its length and CRC.
+ */
+
+static void png_chunk( std::vector<uint8_t> &p_out, const char *p_type, const std::vector<uint8_t> &p_data )
+{
+  png_put32( p_out, p_data.size() );
+  size_t l_start = p_out.size();
+  p_out.insert( p_out.end(), p_type, p_type + 4 );
+  p_out.insert( p_out.end(), p_data.begin(), p_data.end() );
+  png_put32( p_out, png_crc( &p_out[l_start], p_out.size() - l_start ) );
+  return;
+}
+
+
+/*
+ * png_write - writes a packed RGB image out as a PNG.
+ */
+
+static bool png_write( const char *p_path, const uint8_t *p_rgb, uint16_t p_width, uint16_t p_height )
+{
+  std::vector<uint8_t> l_png, l_header, l_raw, l_zlib;
+
+  /* The header; 8 bit RGB, not interlaced. */
+  png_put32( l_header, p_width );
+  png_put32( l_header, p_height );
+  l_header.insert( l_header.end(), { 8, 2, 0, 0, 0 } );
+
+  /* Each row starts with its filter type, which is always none. */
+  for ( uint16_t l_row = 0; l_row < p_height; l_row++ )
+  {
+    l_raw.push_back( 0 );
+    l_raw.insert( l_raw.end(), p_rgb + l_row * p_width * 3, p_rgb + ( l_row + 1 ) * p_width * 3 );
+  }
+
+  /* Wrap that in zlib, as a run of stored blocks, with its checksum. */
+  uint32_t l_adler_a = 1, l_adler_b = 0;
+  l_zlib.push_back( 0x78 );
+  l_zlib.push_back( 0x01 );
+  for ( size_t l_offset = 0; l_offset < l_raw.size(); l_offset += 65535 )
+  {
+    uint16_t l_length = ( l_raw.size() - l_offset > 65535 ) ? 65535 : ( l_raw.size() - l_offset );
+    l_zlib.push_back( ( l_offset + l_length >= l_raw.size() ) ? 1 : 0 );
+    l_zlib.push_back( l_length & 0xFF );
+    l_zlib.push_back( l_length >> 8 );
+    l_zlib.push_back( ~l_length & 0xFF );
+    l_zlib.push_back( ( ~l_length >> 8 ) & 0xFF );
+    l_zlib.insert( l_zlib.end(), l_raw.begin() + l_offset, l_raw.begin() + l_offset + l_length );
+  }
+  for ( uint8_t l_byte : l_raw )
+  {
+    l_adler_a = ( l_adler_a + l_byte ) % 65521;
+    l_adler_b = ( l_adler_b + l_adler_a ) % 65521;
+  }
+  png_put32( l_zlib, ( l_adler_b << 16 ) | l_adler_a );
+
+  /* And assemble the file. */
+  l_png.insert( l_png.end(), { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' } );
+  png_chunk( l_png, "IHDR", l_header );
+  png_chunk( l_png, "IDAT", l_zlib );
+  png_chunk( l_png, "IEND", {} );
+
+  FILE *l_file = fopen( p_path, "wb" );
+  if ( nullptr == l_file )
+  {
+    return false;
+  }
+  bool l_written = ( fwrite( l_png.data(), 1, l_png.size(), l_file ) == l_png.size() );
+  fclose( l_file );
+
+  /* All done. */
+  return l_written;
+}
+
+
+/*
+ * png_read - reads back an RGB PNG that png_write wrote; anything compressed
+ *            or filtered is beyond us, and fails.
+ */
+
+static bool png_read( const char *p_path, std::vector<uint8_t> &p_rgb, uint16_t p_width, uint16_t p_height )
+{
+  std::vector<uint8_t> l_png, l_zlib, l_raw;
+
+  /* Read in the whole file. */
+  FILE *l_file = fopen( p_path, "rb" );
+  if ( nullptr == l_file )
+  {
+    return false;
+  }
+  uint8_t l_buffer[4096];
+  size_t  l_read;
+  while ( ( l_read = fread( l_buffer, 1, sizeof( l_buffer ), l_file ) ) > 0 )
+  {
+    l_png.insert( l_png.end(), l_buffer, l_buffer + l_read );
+  }
+  fclose( l_file );
+
+  /* Walk the chunks, checking the header and gathering the image data. */
+  if ( ( l_png.size() < 8 ) || ( 0 != memcmp( &l_png[1], "PNG", 3 ) ) )
+  {
+    return false;
+  }
+  for ( size_t l_offset = 8; l_offset + 12 <= l_png.size(); )
+  {
+    uint32_t l_length = png_get32( &l_png[l_offset] );
+    const uint8_t *l_type = &l_png[l_offset + 4];
+    const uint8_t *l_data = &l_png[l_offset + 8];
+    if ( l_offset + 12 + l_length > l_png.size() )
+    {
+      return false;
+    }
+    if ( ( 0 == memcmp( l_type, "IHDR", 4 ) ) &&
+         ( ( png_get32( l_data ) != p_width ) || ( png_get32( l_data + 4 ) != p_height ) ||
+           ( 8 != l_data[8] ) || ( 2 != l_data[9] ) || ( 0 != l_data[12] ) ) )
+    {
+      return false;
+    }
+    if ( 0 == memcmp( l_type, "IDAT", 4 ) )
+    {
+      l_zlib.insert( l_zlib.end(), l_data, l_data + l_length );
+    }
+    l_offset += 12 + l_length;
+  }
+
+  /* Unpack the stored blocks. */
+  for ( size_t l_offset = 2; l_offset + 5 <= l_zlib.size(); )
+  {
+    uint8_t  l_flags = l_zlib[l_offset];
+    uint16_t l_length = l_zlib[l_offset + 1] | ( l_zlib[l_offset + 2] << 8 );
+    if ( ( 0 != ( l_flags & 0x06 ) ) || ( l_offset + 5 + l_length > l_zlib.size() ) )
+    {
+      return false;
+    }
+    l_raw.insert( l_raw.end(), l_zlib.begin() + l_offset + 5, l_zlib.begin() + l_offset + 5 + l_length );
+    l_offset += 5 + l_length;
+    if ( l_flags & 0x01 )
+    {
+      break;
+    }
+  }
+
+  /* And strip off the filter bytes, which must all be none. */
+  if ( l_raw.size() != (size_t)p_height * ( p_width * 3 + 1 ) )
+  {
+    return false;
+  }
+  p_rgb.clear();
+  for ( uint16_t l_row = 0; l_row < p_height; l_row++ )
+  {
+    const uint8_t *l_line = &l_raw[l_row * ( p_width * 3 + 1 )];
+    if ( 0 != l_line[0] )
+    {
+      return false;
+    }
+    p_rgb.insert( p_rgb.end(), l_line + 1, l_line + 1 + p_width * 3 );
+  }
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * capture_time - draws the current view into the screen a few times, to get
+ *                a fair idea of how long it takes; returns the time for one
+ *                frame, in microseconds. The time is fixed, so that anything
+ *                animated comes out the same. Also counts the allocations
+ *                made by all but the first frame, which should be none.
+ */
+
+static uint32_t capture_time( uint32_t *p_allocations )
+{
+  blit::Rect l_clip = blit::Rect( blit::Point( 0, 0 ), blit::screen.bounds );
+  uint32_t   l_start = blit::now_us();
+  uint32_t   l_allocs = 0;
+
+  for ( uint8_t l_loop = 0; l_loop < CAPTURE_LOOPS; l_loop++ )
+  {
+    if ( 1 == l_loop )
+    {
+      l_allocs = alloc_total();
+    }
+    blit::screen.clip = l_clip;
+    render_frame( 0 );
+  }
+  *p_allocations += alloc_total() - l_allocs;
+
+  return blit::us_diff( l_start, blit::now_us() ) / CAPTURE_LOOPS;
+}
+
+
+/*
+ * capture_ticks - runs a few updates in the mode given, with no input and the
+ *                 time held still so that nothing starts moving; returns the
+ *                 allocations made by all but the first, which should be
+ *                 none.
+ */
+
+static uint32_t capture_ticks( const capture_t &p_capture )
+{
+  uint32_t l_allocs = 0;
+
+  g_mode = p_capture.mode;
+  g_level = p_capture.level;
+  g_zoom = p_capture.zoom;
+
+  for ( uint8_t l_tick = 0; l_tick < CAPTURE_TICKS; l_tick++ )
+  {
+    if ( 1 == l_tick )
+    {
+      l_allocs = alloc_total();
+    }
+    update( 0 );
+  }
+
+  return alloc_total() - l_allocs;
+}
+
+
+/*
+ * capture_run - draws each of the captures into an off-screen surface the
+ *               size of the hires screen, times it, and checks it against its
+ *               golden image; a missing golden is a failure. Setting
+ *               SOKOBLIT_GOLDEN_UPDATE in the environment saves each one as
+ *               the new golden instead. If tilemaps are drawn across threads,
+ *               each frame is drawn on a single thread too, and the two
+ *               must agree exactly; and if allocations are being counted,
+ *               neither drawing a frame again nor a steady update may
+ *               allocate. Never returns.
+ */
+
+void capture_run( void )
+{
+  const uint16_t       l_width = SOKOBLIT_WORLD_W;
+  const uint16_t       l_height = SOKOBLIT_WORLD_H;
+  std::vector<uint8_t> l_pixels( l_width * l_height * 3 );
+  std::vector<uint8_t> l_golden, l_single;
+  blit::Surface        l_surface( l_pixels.data(), blit::PixelFormat::RGB, blit::Size( l_width, l_height ) );
+  bool                 l_update = ( nullptr != getenv( CAPTURE_UPDATE_ENV ) );
+  uint8_t              l_failures = 0;
+  char                 l_name[64], l_path[128];
+
+  std::filesystem::create_directories( CAPTURE_DIR );
+  std::filesystem::create_directories( CAPTURE_GOLDEN_DIR );
+
+  /* Remember where we were, as the captures move us all around. */
+  uimode_t l_mode = g_mode;
+  uint8_t  l_level = g_level;
+  uint8_t  l_zoom = g_zoom;
+  bool     l_pooled = g_renderpool.enabled();
+
+  for ( const capture_t &l_capture : g_captures )
+  {
+    RenderTarget l_target( l_surface );
+
+    g_mode = l_capture.mode;
+    g_level = l_capture.level;
+    g_zoom = l_capture.zoom;
+
+    /* Time it on a single thread first and then, if we can, across all */
+    /* of them; whichever way it's drawn, it has to come out the same.  */
+    uint32_t l_allocations = 0;
+    g_renderpool.enable( false );
+    uint32_t l_single_us = capture_time( &l_allocations );
+    uint32_t l_pooled_us = l_single_us;
+    bool     l_threads_agree = true;
+    if ( l_pooled )
+    {
+      l_single = l_pixels;
+      g_renderpool.enable( true );
+      l_pooled_us = capture_time( &l_allocations );
+      l_threads_agree = ( l_single == l_pixels );
+    }
+
+    /* Save it, and see how it compares with the golden copy. */
+    snprintf( l_name, sizeof( l_name ), "mode%u-level%02u-zoom%03u.png",
+              (unsigned)l_capture.mode, (unsigned)l_capture.level, (unsigned)l_capture.zoom );
+    snprintf( l_path, sizeof( l_path ), "%s/%s", CAPTURE_DIR, l_name );
+    png_write( l_path, l_pixels.data(), l_width, l_height );
+
+    snprintf( l_path, sizeof( l_path ), "%s/%s", CAPTURE_GOLDEN_DIR, l_name );
+    const char *l_result;
+    if ( l_update )
+    {
+      l_result = "saved";
+      if ( !png_write( l_path, l_pixels.data(), l_width, l_height ) )
+      {
+        l_result = "SAVE FAILED";
+        l_failures++;
+      }
+    }
+    else if ( !std::filesystem::exists( l_path ) )
+    {
+      l_result = "NO GOLDEN";
+      l_failures++;
+    }
+    else if ( !png_read( l_path, l_golden, l_width, l_height ) )
+    {
+      l_result = "UNREADABLE";
+      l_failures++;
+    }
+    else
+    {
+      uint32_t l_differ = 0;
+      for ( uint32_t l_pixel = 0; l_pixel < (uint32_t)l_width * l_height; l_pixel++ )
+      {
+        if ( 0 != memcmp( &l_pixels[l_pixel * 3], &l_golden[l_pixel * 3], 3 ) )
+        {
+          l_differ++;
+        }
+      }
+      l_result = ( 0 == l_differ ) ? "match" : "DIFFER";
+      if ( l_differ > 0 )
+      {
+        blit::debugf( "capture: %s has %lu pixels different\n", l_name, (unsigned long)l_differ );
+        l_failures++;
+      }
+    }
+
+    if ( !l_threads_agree )
+    {
+      l_result = "THREADS DIFFER";
+      l_failures++;
+    }
+    else if ( l_allocations > 0 )
+    {
+      blit::debugf( "capture: %s made %lu allocations\n", l_name, (unsigned long)l_allocations );
+      l_result = "ALLOCATES";
+      l_failures++;
+    }
+
+    blit::debugf( "capture: %-32s %6lu us/frame, %6lu us on %u threads  %s\n", l_name,
+                  (unsigned long)l_single_us, (unsigned long)l_pooled_us,
+                  (unsigned)g_renderpool.threads(), l_result );
+  }
+
+  /* Updates in the steady modes mustn't allocate once they've settled, */
+  /* any more than drawing does.                                        */
+  for ( const capture_t &l_tick : g_tick_modes )
+  {
+    uint32_t l_allocations = capture_ticks( l_tick );
+    if ( l_allocations > 0 )
+    {
+      l_failures++;
+    }
+    blit::debugf( "capture: update in mode %u, %lu allocations  %s\n", (unsigned)l_tick.mode,
+                  (unsigned long)l_allocations, ( l_allocations > 0 ) ? "ALLOCATES" : "ok" );
+  }
+
+  /* Put everything back, although we're about to leave anyway. */
+  g_mode = l_mode;
+  g_level = l_level;
+  g_zoom = l_zoom;
+  g_renderpool.enable( l_pooled );
+
+  blit::debugf( "capture: %u of %u checks failed\n", (unsigned)l_failures,
+                (unsigned)( sizeof( g_captures ) / sizeof( g_captures[0] ) +
+                            sizeof( g_tick_modes ) / sizeof( g_tick_modes[0] ) ) );
+  exit( l_failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS );
+}
+
+#else
+
+/*
+ * capture_run - without capture support, there's nothing to do.
+ */
+
+void capture_run( void )
+{
+  return;
+}
+
+#endif /* SOKOBLIT_CAPTURE */
+
+
+/* End of file Capture.cpp */
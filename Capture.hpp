@@ -0,0 +1,43 @@
+/*
+ * Capture.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Off-screen capture, for checking and timing rendering changes. When built
+ * with SOKOBLIT_CAPTURE on the host, a fixed set of levels and zooms is drawn
+ * into an off-screen surface rather than the window; each frame is written
+ * out as a PNG, compared pixel for pixel against a golden copy, and timed.
+ * The game then exits, with a failure status if anything differed.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _CAPTURE_HPP_
+#define   _CAPTURE_HPP_
+
+#include "32blit.hpp"
+
+#define CAPTURE_DIR         "capture"
+#define CAPTURE_GOLDEN_DIR  "golden"
+#define CAPTURE_UPDATE_ENV  "SOKOBLIT_GOLDEN_UPDATE"
+#define CAPTURE_LOOPS       50
+#define CAPTURE_TICKS       10      /* updates run in each steady mode */
+
+/* Points the screen at another surface for as long as this is in scope, so */
+/* that everything which draws to the screen draws there instead.           */
+
+class RenderTarget
+{
+  private:
+    blit::Surface   c_saved;
+
+  public:
+                    RenderTarget( blit::Surface & );
+                   ~RenderTarget( void );
+};
+
+void        capture_run( void );
+
+#endif /* _CAPTURE_HPP_ */
+
+/* End of file Capture.hpp */
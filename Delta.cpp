@@ -0,0 +1,115 @@
+/*
+ * Delta.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The DeltaQueue carries changes to the game map over to anyone else who is
+ * drawing it (which is to say, the menu); the game pushes a small event for
+ * each crate that moves, and the menu pops them off whenever it's ready.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstring>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Delta.hpp"
+
+
+/* Module variables. */
+
+DeltaQueue g_deltas;
+
+
+/* Functions. */
+
+/*
+ * DeltaQueue - constructor, which starts empty.
+ */
+
+DeltaQueue::DeltaQueue( void )
+{
+  memset( c_ring, 0, sizeof( c_ring ) );
+  c_head = 0;
+  c_tail = 0;
+  memset( c_dirty, 0, sizeof( c_dirty ) );
+  c_overflows = 0;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * push - adds an event to the queue; if it's full, the event's level is
+ *        marked dirty instead (so it will be resynced as a whole) and we
+ *        return false. The queue is drained every tick, so this should be
+ *        rare in practice.
+ */
+
+bool DeltaQueue::push( const tiledelta_t &p_delta )
+{
+  /* Check there's room; if not, the whole level will need resyncing. */
+  if ( (uint16_t)( c_head - c_tail ) >= DELTA_MAX )
+  {
+    if ( 0 == ( c_dirty[p_delta.level / 8] & ( 1 << ( p_delta.level % 8 ) ) ) )
+    {
+      c_dirty[p_delta.level / 8] |= ( 1 << ( p_delta.level % 8 ) );
+      blit::debugf( "DeltaQueue full (%u times), level %u will be resynced\n",
+                    (unsigned)++c_overflows, (unsigned)p_delta.level );
+    }
+    return false;
+  }
+
+  /* Add it to the head. */
+  c_ring[c_head % DELTA_MAX] = p_delta;
+  c_head++;
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * pop - takes the oldest event off the queue; once that's empty, any level
+ *       marked dirty comes off as a single DELTA_LEVEL_DIRTY event. Returns
+ *       false if there's nothing at all.
+ */
+
+bool DeltaQueue::pop( tiledelta_t &p_delta )
+{
+  /* Anything queued comes first. */
+  if ( c_head != c_tail )
+  {
+    p_delta = c_ring[c_tail % DELTA_MAX];
+    c_tail++;
+    return true;
+  }
+
+  /* Then the dirty levels; they're resynced after everything else, so */
+  /* whatever they pick up is the latest.                               */
+  for ( uint8_t l_level = 0; l_level <= SOKOBLIT_LEVEL_MAX; l_level++ )
+  {
+    if ( c_dirty[l_level / 8] & ( 1 << ( l_level % 8 ) ) )
+    {
+      c_dirty[l_level / 8] &= ~( 1 << ( l_level % 8 ) );
+      memset( &p_delta, 0, sizeof( p_delta ) );
+      p_delta.kind = DELTA_LEVEL_DIRTY;
+      p_delta.level = l_level;
+      return true;
+    }
+  }
+
+  /* All done, nothing left. */
+  return false;
+}
+
+
+/* End of file Delta.cpp */
@@ -0,0 +1,60 @@
+/*
+ * Delta.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The DeltaQueue carries changes to the game map over to anyone else who is
+ * drawing it (which is to say, the menu); the game pushes a small event for
+ * each crate that moves, and the menu pops them off whenever it's ready. If
+ * the queue ever fills, the level is marked dirty instead, and comes back
+ * out as a single event asking for that level to be resynced.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _DELTA_HPP_
+#define   _DELTA_HPP_
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+#include "Metatile.hpp"
+
+#define DELTA_MAX           64      /* must be a power of two */
+#define DELTA_DIRTY_BYTES   ( ( SOKOBLIT_LEVEL_MAX + 8 ) / 8 )
+
+typedef enum
+{
+  DELTA_TILE,                       /* a (2x2) tile has changed            */
+  DELTA_LEVEL_RESET,                /* the whole level is back as it was   */
+  DELTA_LEVEL_DIRTY                 /* changes were lost; resync the level */
+} deltakind_t;
+
+typedef struct
+{
+  uint8_t     kind;
+  uint8_t     level;
+  uint8_t     x;                    /* full map tile co-ordinates          */
+  uint8_t     y;
+  uint8_t     tiles[METATILE_TILES];  /* what it looks like now            */
+} tiledelta_t;
+
+class DeltaQueue
+{
+  private:
+    tiledelta_t     c_ring[DELTA_MAX];
+    uint16_t        c_head;
+    uint16_t        c_tail;
+    uint8_t         c_dirty[DELTA_DIRTY_BYTES];
+    uint16_t        c_overflows;
+
+  public:
+                    DeltaQueue( void );
+    bool            push( const tiledelta_t & );
+    bool            pop( tiledelta_t & );
+};
+
+extern DeltaQueue g_deltas;
+
+#endif /* _DELTA_HPP_ */
+
+/* End of file Delta.hpp */
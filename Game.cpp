@@ -19,229 +19,674 @@
 #include "32blit.hpp"
 #include "sokoblit.hpp"
 
+#include "Arena.hpp"
+#include "AssetPack.hpp"
+#include "Attract.hpp"
+#include "Delta.hpp"
 #include "Game.hpp"
+#include "Geometry.hpp"
+#include "Governor.hpp"
+#include "Menu.hpp"
+#include "RenderPool.hpp"
+#include "Rules.hpp"
+#include "Trace.hpp"
 #include "assets_tiled.hpp"
+#include "assets_font.hpp"
 
 
 /* Functions. */
 
 /*
- * Game - constructor, where we load up our tile map stuff.
+ * Game - constructor; this does very little, as the real work of loading
+ *        everything up is done in stages by load().
  */
 
 Game::Game( void )
 {
-  /* Load up the spritesheet we'll be using, attach it to the screen too. */
-  c_game_sprites = blit::Surface::load( at_game_sprites );
-  blit::screen.sprites = c_game_sprites;
+  /* Players live in the arena too, one per level, but start empty. */
+  memset( c_player, 0, sizeof( c_player ) );
+
+  /* Nothing is loaded yet. */
+  c_game_sprites = nullptr;
+  c_game_sheet = nullptr;
+  c_game_map = at_game_map;
+  c_overview_map = nullptr;
+  c_metatiles = nullptr;
+  c_cells = nullptr;
+  c_cells_level = 0;
+  memset( c_crates, 0, sizeof( c_crates ) );
+  memset( c_initial, 0, sizeof( c_initial ) );
+  c_font = nullptr;
+  c_pack = nullptr;
+  c_loadstate = LOAD_SPRITES;
+  c_phase_start = 0;
+  c_loadlevel = 1;
+  c_revision = 0;
 
-  /* And the tile map, too - copied into a malleable chunk of memory. */
-  c_game_tiles = new uint8_t[at_game_map_length];
-  if ( nullptr == c_game_tiles )
+  /* And a few other defaults. */
+  c_zoom = 1;
+
+  /* The tilemap callback is made just the once; capturing no more than */
+  /* us, it fits inside the function and so never touches the heap.    */
+  c_map_scanline = [this]( uint8_t p_scanline ) { return map_transform( p_scanline ); };
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * load - performs the next stage of loading up the game; each call does a
+ *        small chunk of the work, so that it can be spread over a number of
+ *        frames if we want. Returns true once there's nothing more to do,
+ *        which is normally because everything is loaded.
+ */
+
+bool Game::load( void )
+{
+  void    *l_block;
+  void    *l_metatiles;
+  uint32_t l_map_length;
+
+  switch( c_loadstate )
   {
-    /* Erk, this is bad, bail out now. */
-    return;
+    case LOAD_SPRITES:
+      /* The first phase begins here; the rest begin as the last one ends. */
+      c_phase_start = blit::now_us();
+
+      /* Load up the spritesheet we'll be using, attach it to the screen too; */
+      /* without a buffer, the load would quietly go to the heap instead.     */
+      l_block = g_arena.alloc( ARENA_GAME_SPRITES, ARENA_SPRITES );
+      if ( nullptr == l_block )
+      {
+        return load_failed( "game sprites" );
+      }
+      c_game_sprites = ASSET_SURFACE( at_game_sprites, (uint8_t *)l_block, ARENA_GAME_SPRITES );
+      if ( nullptr == c_game_sprites )
+      {
+        return load_failed( "game sprites" );
+      }
+      if ( ARENA_GAME_FORMAT != c_game_sprites->format )
+      {
+        blit::debugf( "Game sprites are not in the format their arena space was sized for\n" );
+      }
+      blit::screen.sprites = c_game_sprites;
+      l_block = g_arena.alloc( sizeof( SpriteSheet ), ARENA_SPRITES );
+      if ( nullptr == l_block )
+      {
+        return load_failed( "game spritesheet" );
+      }
+      c_game_sheet = new( l_block ) SpriteSheet( c_game_sprites );
+
+      /* The font is shared between all the players, so only needs loading once. */
+      l_block = g_arena.alloc( sizeof( blit::Font ), ARENA_FONTS );
+      if ( nullptr == l_block )
+      {
+        return load_failed( "game font" );
+      }
+      c_font = new( l_block ) blit::Font( ASSET( a_font ) );
+
+      log_phase( "game sprites", c_phase_start );
+      c_phase_start = blit::now_us();
+      c_loadstate = LOAD_MAP;
+      break;
+
+    case LOAD_MAP:
+      /* The full map is only ever looked at, so it's drawn straight from */
+      /* flash (or the asset pack); just the level's cells are malleable. */
+      c_cells = (uint8_t *)g_arena.alloc( GAME_CELLS_W * GAME_CELLS_H, ARENA_TILEMAPS );
+      l_metatiles = g_arena.alloc( sizeof( MetatileSet ), ARENA_TILEMAPS );
+      if ( ( nullptr == c_cells ) || ( nullptr == l_metatiles ) )
+      {
+        /* Erk, this is bad; we'll never get any further than this. */
+        return load_failed( "game cells" );
+      }
+      c_metatiles = new( l_metatiles ) MetatileSet();
+
+      /* The level layout is fixed, so a packed map must be the same size. */
+      c_game_map = g_assets.find( "at_game_map", at_game_map, at_game_map_length, &l_map_length );
+      if ( at_game_map_length != l_map_length )
+      {
+        blit::debugf( "Asset pack map is the wrong size, using the built in one\n" );
+        c_game_map = at_game_map;
+      }
+      l_block = g_arena.alloc( sizeof( blit::TileMap ), ARENA_TILEMAPS );
+      if ( nullptr == l_block )
+      {
+        return load_failed( "game map" );
+      }
+      c_overview_map = new( l_block )
+                         blit::TileMap( (uint8_t *)c_game_map, nullptr, blit::Size( 256, 256 ), c_game_sprites );
+
+      /* Crates can be pushed onto any floor, so they need a block whether */
+      /* or not the levels start with one; so does the floor they leave.  */
+      c_metatiles->add( TILED_CRATE );
+      c_metatiles->add( TILED_EMPTY );
+
+      log_phase( "game map", c_phase_start );
+      c_phase_start = blit::now_us();
+      c_loadstate = LOAD_LEVELS;
+      break;
+
+    case LOAD_LEVELS:
+      /* Levels are scanned one at a time; they count from one, so slot */
+      /* zero is never used.                                            */
+      if ( !load_level( c_loadlevel ) )
+      {
+        /* No room for the level; load_level has already said why. */
+        c_loadstate = LOAD_FAILED;
+        return true;
+      }
+      if ( SOKOBLIT_LEVEL_MAX == c_loadlevel++ )
+      {
+        fill_cells( g_level );
+        log_phase( "game levels", c_phase_start );
+        c_phase_start = blit::now_us();
+        c_loadstate = LOAD_PACK;
+      }
+      break;
+
+    case LOAD_PACK:
+      /* If there's an external level pack, index it a step at a time; */
+      /* the levels themselves are only read as and when they're wanted. */
+      if ( nullptr == c_pack )
+      {
+        /* Only find room for the pack once we know we can read it. */
+        packfile_t l_file;
+        if ( !levelpack_open( LEVELPACK_FILE, l_file ) )
+        {
+          c_loadstate = LOAD_DONE;
+          break;
+        }
+        uint32_t *l_index = (uint32_t *)g_arena.alloc( LEVELPACK_MAX_LEVELS * sizeof( uint32_t ), ARENA_LEVELS );
+        void     *l_pack = g_arena.alloc( sizeof( LevelPack ), ARENA_LEVELS );
+        if ( ( nullptr == l_index ) || ( nullptr == l_pack ) )
+        {
+          levelpack_close( l_file );
+          return load_failed( "level pack" );
+        }
+        c_pack = new( l_pack ) LevelPack( l_file, l_index );
+      }
+      if ( !c_pack->index() )
+      {
+        break;
+      }
+
+      /* That's the whole file indexed; a pack with no levels is no use. */
+      if ( c_pack->count() > 0 )
+      {
+        blit::debugf( "Level pack: %u levels\n", (unsigned)c_pack->count() );
+      }
+      else
+      {
+        c_pack->~LevelPack();
+        c_pack = nullptr;
+      }
+      log_phase( "level pack", c_phase_start );
+      c_loadstate = LOAD_DONE;
+      break;
+
+    case LOAD_DONE:
+    case LOAD_FAILED:
+      break;
   }
-  memcpy( c_game_tiles, at_game_map, at_game_map_length );
-  c_game_map = new blit::TileMap( c_game_tiles, nullptr, blit::Size( 256, 256 ), c_game_sprites );
 
-  /* Scan each level to find the player's starting location. */
-  for( uint8_t l_level = 0; l_level < SOKOBLIT_LEVEL_MAX; l_level++ )
+  /* All done, let the caller know if there's any more to do. */
+  return ( LOAD_DONE == c_loadstate ) || ( LOAD_FAILED == c_loadstate );
+}
+
+
+/*
+ * load_failed - gives up on loading, saying which part of the game couldn't
+ *               find the room it needed. Returns true, as load() would.
+ */
+
+bool Game::load_failed( const char *p_subsystem )
+{
+  blit::debugf( "Game load failed: out of arena for %s\n", p_subsystem );
+  c_loadstate = LOAD_FAILED;
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * ready - returns a boolean flag indicating if everything is loaded.
+ */
+
+bool Game::ready( void )
+{
+  /* Pretty simple access method. */
+  return LOAD_DONE == c_loadstate;
+}
+
+
+/*
+ * pack - returns the external level pack, if there is one.
+ */
+
+LevelPack *Game::pack( void )
+{
+  /* Pretty simple access method. */
+  return c_pack;
+}
+
+
+/*
+ * sprites - returns the game's spritesheet, for anyone drawing the map.
+ */
+
+blit::Surface *Game::sprites( void )
+{
+  /* Pretty simple access method. */
+  return c_game_sprites;
+}
+
+
+/*
+ * signature - returns a value which changes whenever anything we draw does;
+ *             the map revision, plus the state of the current player.
+ */
+
+uint32_t Game::signature( void )
+{
+  /* Nothing to see until we're loaded. */
+  if ( !ready() )
   {
-    blit::Point l_origin = level_tile_origin( l_level );
-    blit::Point l_tile;
+    return 0;
+  }
+
+  return c_revision ^ c_player[g_level]->signature();
+}
+
 
-    /* Work through all the tiles, looking for the player. Sprites are 2x2 */
-    /* though, so we only need to check alternate rows/columns...          */
-    bool l_found = false;
-    for ( uint8_t y = 0; y < 30; y += 2 )
+/*
+ * untouched - returns true if a level is still just as it was loaded; the
+ *             player hasn't moved, and so neither has any crate.
+ */
+
+bool Game::untouched( uint8_t p_level )
+{
+  /* Levels without a player can't be played at all. */
+  if ( ( p_level > SOKOBLIT_LEVEL_MAX ) || ( nullptr == c_player[p_level] ) )
+  {
+    return false;
+  }
+
+  return ( 0 == c_player[p_level]->moves() ) &&
+         ( 0 == memcmp( c_crates[p_level], c_initial[p_level], GAME_CRATE_BYTES ) );
+}
+
+
+/*
+ * solved - returns true if every crate in a level is sitting on a home.
+ */
+
+bool Game::solved( uint8_t p_level )
+{
+  blit::Point l_origin = level_tile_origin( p_level );
+  blit::Point l_tile;
+
+  for ( uint8_t y = 0; y < LAYOUT_LEVEL_H; y += RULES_CELL )
+  {
+    l_tile.y = l_origin.y + y;
+    for ( uint8_t x = 0; x < LAYOUT_LEVEL_W; x += RULES_CELL )
     {
-      l_tile.y = l_origin.y + y;
-      for ( uint8_t x = 0; x < 40; x += 2 )
+      l_tile.x = l_origin.x + x;
+      if ( crate_bit( p_level, l_tile ) && ( TILED_CRATE_HOME != c_game_map[c_overview_map->offset( l_tile )] ) )
       {
-        l_tile.x = l_origin.x + x;
-        if ( c_game_map->tile_at( l_tile ) == TILED_PLAYER_HOME )
-        {
-          c_player[l_level] = new Player( x, y );
-          l_found = true;
+        return false;
+      }
+    }
+  }
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * load_level - scans the requested level, setting up the per-level state
+ *              for it; that's finding where the player starts, noting where
+ *              all the crates are, and adding its blocks to the metatiles.
+ *              Returns false if there's no room left for them, or for
+ *              its player.
+ */
+
+bool Game::load_level( uint8_t p_level )
+{
+  blit::Point l_origin = level_tile_origin( p_level );
+  blit::Point l_tile;
+  void       *l_player;
+
+  /* Work through all the tiles, straight from flash. Sprites are 2x2 */
+  /* though, so we only need to check alternate rows/columns...       */
+  for ( uint8_t y = 0; y < LAYOUT_LEVEL_H; y += RULES_CELL )
+  {
+    l_tile.y = l_origin.y + y;
+    for ( uint8_t x = 0; x < LAYOUT_LEVEL_W; x += RULES_CELL )
+    {
+      l_tile.x = l_origin.x + x;
+      if ( c_metatiles->add( &c_game_map[c_overview_map->offset( l_tile )], c_overview_map->bounds.w ) < 0 )
+      {
+        /* More distinct blocks than we have room for; the map is wrong. */
+        blit::debugf( "Level %u has too many metatiles\n", (unsigned)p_level );
+        return false;
+      }
+      switch( c_game_map[c_overview_map->offset( l_tile )] )
+      {
+        case TILED_PLAYER_HOME:
+          l_player = g_arena.alloc( sizeof( Player ), ARENA_LEVELS );
+          if ( nullptr == l_player )
+          {
+            blit::debugf( "Game load failed: out of arena for the level %u player\n", (unsigned)p_level );
+            return false;
+          }
+          c_player[p_level] = new( l_player ) Player( x, y, c_font );
+          break;
+        case TILED_CRATE:
+          set_crate_bit( p_level, l_tile, true );
           break;
-        }
       }
-      if ( l_found ) break;
     }
   }
 
-  /* And a few other defaults. */
-  c_zoom = 1;
+  /* Keep a snapshot of how the crates started, for restarting. */
+  memcpy( c_initial[p_level], c_crates[p_level], GAME_CRATE_BYTES );
 
-  /* All done! */
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * restart_level - puts a level back the way it started; the crates come back
+ *                 from the snapshot taken when it was loaded, and the cells
+ *                 are refilled from that.
+ */
+
+void Game::restart_level( uint8_t p_level )
+{
+  /* Restore the crates in one go, and refill the cells from them. */
+  memcpy( c_crates[p_level], c_initial[p_level], GAME_CRATE_BYTES );
+  fill_cells( p_level );
+
+  /* Anyone else drawing the map can just forget what's changed. */
+  tiledelta_t l_delta;
+  memset( &l_delta, 0, sizeof( l_delta ) );
+  l_delta.kind = DELTA_LEVEL_RESET;
+  l_delta.level = p_level;
+  g_deltas.push( l_delta );
+
+  /* And put the player back at the start. */
+  c_player[p_level]->reset();
+
+  /* All done. */
   return;
 }
 
 
 /*
- * ~Game - destructor, just tidy up what we allocated.
+ * ~Game - destructor, just tidy up what we allocated. Anything carved out of
+ *         the arena is simply destructed; the memory itself is never freed.
  */
 
 Game::~Game( void )
 {
-  /* Free the tilemap. */
-  if ( nullptr != c_game_map )
+  /* Free the tilemap, and the cells. */
+  if ( nullptr != c_overview_map )
   {
-    delete c_game_map;
-    c_game_map = nullptr;
+    c_overview_map->~TileMap();
+    c_overview_map = nullptr;
   }
-  if ( nullptr != c_game_tiles )
+  if ( nullptr != c_metatiles )
   {
-    delete c_game_tiles;
-    c_game_tiles = nullptr;
+    c_metatiles->~MetatileSet();
+    c_metatiles = nullptr;
   }
+  c_cells = nullptr;
 
   /* And the sprites. */
+  if ( nullptr != c_game_sheet )
+  {
+    c_game_sheet->~SpriteSheet();
+    c_game_sheet = nullptr;
+  }
   if ( nullptr != c_game_sprites )
   {
     delete c_game_sprites;
     c_game_sprites = nullptr;
   }
 
-  /* Lastly all those lovely Player objects. */
-  for( uint8_t l_level = 0; l_level < SOKOBLIT_LEVEL_MAX; l_level++ )
+  /* All those lovely Player objects. */
+  for( uint8_t l_level = 0; l_level <= SOKOBLIT_LEVEL_MAX; l_level++ )
   {
     if ( nullptr != c_player[l_level] )
     {
-      delete c_player[l_level];
+      c_player[l_level]->~Player();
       c_player[l_level] = nullptr;
     }
   }
 
+  /* The level pack, if we had one. */
+  if ( nullptr != c_pack )
+  {
+    c_pack->~LevelPack();
+    c_pack = nullptr;
+  }
+
+  /* And lastly the font they were sharing. */
+  if ( nullptr != c_font )
+  {
+    c_font->~Font();
+    c_font = nullptr;
+  }
+
   /* All done. */
   return;
 }
 
 
 /*
- * level_rect - determines the screen Rect for a given level, taking into 
- *              account the current zoom.
+ * cell_offset - works out which cell of the current level a (full map) tile
+ *               location lives in; returns -1 if it's outside of the level.
  */
 
-blit::Rect Game::level_rect( uint8_t p_level )
+int32_t Game::cell_offset( blit::Point p_location )
 {
-  blit::Rect l_rect = blit::Rect( 0, 0, 0, 0 );
+  blit::Point l_local = p_location - level_tile_origin( c_cells_level );
 
-  /* Work out the zoomed size of it. */
-  l_rect.w = blit::screen.bounds.w / ( 1.0f + c_zoom / 25.0f ) - 2;
-  l_rect.h = blit::screen.bounds.h / ( 1.0f + c_zoom / 25.0f ) - 2;
+  /* Make sure it's inside. */
+  if ( ( l_local.x < 0 ) || ( l_local.x >= LAYOUT_LEVEL_W ) ||
+       ( l_local.y < 0 ) || ( l_local.y >= LAYOUT_LEVEL_H ) )
+  {
+    return -1;
+  }
 
-  /* And then work out the location, too - start with the map location. */
-  blit::Point l_levelloc = level_centre( p_level );
-  blit::Vec2 l_centre = blit::Vec2( l_levelloc.x, l_levelloc.y ); 
-  l_centre.x -= blit::screen.bounds.w / 2;
-  l_centre.y -= blit::screen.bounds.h / 2;
-  l_centre -= l_centre * ( 1.0f - c_zoom / 100.0f );
+  /* Then it's a simple offset. */
+  return ( l_local.x / RULES_CELL ) + ( ( l_local.y / RULES_CELL ) * GAME_CELLS_W );
+}
 
-  /* Apply the zoom transform. */
-  l_rect.x = l_centre.x / ( 1.0f + c_zoom / 25.0f ) + 1;
-  l_rect.y = l_centre.y / ( 1.0f + c_zoom / 25.0f ) + 1;
 
-  /* All done. */
-  return l_rect;
+/*
+ * crate_bit - returns the saved crate state of a (full map) tile location
+ *             within the given level.
+ */
+
+bool Game::crate_bit( uint8_t p_level, blit::Point p_location )
+{
+  blit::Point l_cell = p_location - level_tile_origin( p_level );
+  uint16_t    l_bit = ( l_cell.y / RULES_CELL ) * GAME_CELLS_W + ( l_cell.x / RULES_CELL );
+
+  return ( c_crates[p_level][l_bit / 8] & ( 1 << ( l_bit % 8 ) ) ) != 0;
 }
 
 
 /*
- * level_tile_origin - determines the origin (in tiles) of the specified level,
- *                     so that we can easily index into the tilemap.
+ * set_crate_bit - updates the saved crate state of a (full map) tile location
+ *                 within the given level.
  */
 
-blit::Point Game::level_tile_origin( uint8_t p_level )
+void Game::set_crate_bit( uint8_t p_level, blit::Point p_location, bool p_crate )
 {
-  blit::Point l_origin = blit::Point( 0, 0 );
+  blit::Point l_cell = p_location - level_tile_origin( p_level );
+  uint16_t    l_bit = ( l_cell.y / RULES_CELL ) * GAME_CELLS_W + ( l_cell.x / RULES_CELL );
 
-  /* Top two rows are easy. */
-  if ( ( p_level >= 1 ) && ( p_level <= 5 ) )
+  if ( p_crate )
   {
-    l_origin.x = 40 * ( p_level - 1 );
-    l_origin.y = 0;
+    c_crates[p_level][l_bit / 8] |= ( 1 << ( l_bit % 8 ) );
   }
-  if ( ( p_level >= 6 ) && ( p_level <= 10 ) )
+  else
   {
-    l_origin.x = 40 * ( p_level - 6 );
-    l_origin.y = 30;
+    c_crates[p_level][l_bit / 8] &= ~( 1 << ( l_bit % 8 ) );
   }
 
-  /* And the last two rows. */
-  if ( ( p_level >= 13 ) && ( p_level <= 17 ) )
-  {
-    l_origin.x = 40 * ( p_level - 13 );
-    l_origin.y = 90;
-  }
-  if ( ( p_level >= 18 ) && ( p_level <= 22 ) )
+  /* All done. */
+  return;
+}
+
+
+/*
+ * fill_cells - points the cells at the given level; each one is looked up
+ *              from the map in flash, and then the crates are put back where
+ *              the player left them.
+ */
+
+void Game::fill_cells( uint8_t p_level )
+{
+  blit::Point l_origin = level_tile_origin( p_level );
+  blit::Point l_tile;
+
+  c_cells_level = p_level;
+
+  /* Every block in the levels was added to the set as they were loaded. */
+  for ( uint8_t y = 0; y < GAME_CELLS_H; y++ )
   {
-    l_origin.x = 40 * ( p_level - 18 );
-    l_origin.y = 120;
+    l_tile.y = l_origin.y + ( y * RULES_CELL );
+    for ( uint8_t x = 0; x < GAME_CELLS_W; x++ )
+    {
+      l_tile.x = l_origin.x + ( x * RULES_CELL );
+      int16_t l_id = c_metatiles->find( &c_game_map[c_overview_map->offset( l_tile )], c_overview_map->bounds.w );
+      c_cells[x + ( y * GAME_CELLS_W )] = ( l_id < 0 ) ? 0 : l_id;
+
+      /* And then bring the crates up to date, where they've moved. */
+      bool l_was_crate = ( TILED_CRATE == c_game_map[c_overview_map->offset( l_tile )] );
+      bool l_is_crate = crate_bit( p_level, l_tile );
+      if ( l_was_crate != l_is_crate )
+      {
+        set_tile( l_tile, l_is_crate ? TILED_CRATE : TILED_RESET );
+      }
+    }
   }
 
-  /* Two edge cases we may as well hard code. */
-  if ( 11 == p_level )
+  /* The map has changed, so it needs redrawing. */
+  c_revision++;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * get_tile - returns the tile at a (full map) location; from the cells if
+ *            it's in the current level, or straight from flash if it isn't.
+ */
+
+uint8_t Game::get_tile( blit::Point p_location )
+{
+  int32_t l_offset = cell_offset( p_location );
+
+  /* The cells are the most up to date, if it's there. */
+  if ( l_offset >= 0 )
   {
-    l_origin.x = 0;
-    l_origin.y = 60;
+    blit::Point l_local = p_location - level_tile_origin( c_cells_level );
+    return c_metatiles->tile( c_cells[l_offset],
+                              ( l_local.x % RULES_CELL ) + ( ( l_local.y % RULES_CELL ) * RULES_CELL ) );
   }
-  if ( 12 == p_level )
+
+  /* Otherwise, fall back to the original. */
+  return map_tile( p_location );
+}
+
+
+/*
+ * map_tile - returns the tile at a (full map) location as it is in flash,
+ *            whatever has happened to it since; off the map is empty.
+ */
+
+uint8_t Game::map_tile( blit::Point p_location )
+{
+  if ( ( p_location.x < 0 ) || ( p_location.x >= c_overview_map->bounds.w ) ||
+       ( p_location.y < 0 ) || ( p_location.y >= c_overview_map->bounds.h ) )
   {
-    l_origin.x = 160;
-    l_origin.y = 60;
+    return 0;
   }
-
-  /* And return the origin. */
-  return l_origin;
+  return c_game_map[c_overview_map->offset( p_location )];
 }
 
 
 /*
- * set_tile - updates the tile map with the new tile type. This takes into 
- *            account the fact that our logical tiles are in fact two game-tiles
- *            square!
+ * set_tile - updates a cell of the current level with the new tile type; our
+ *            logical tiles are two game-tiles square, but each is a single
+ *            metatile. Locations are in full map tiles, and the crate state
+ *            of the level is kept up to date as we go.
  */
 
 bool Game::set_tile( blit::Point p_location, uint8_t p_type )
 {
-  /* A very quick sanity check that we're on the actual map! */
-  if ( ( p_location.x > ( c_game_map->bounds.w - 2 ) ) ||
-       ( p_location.y > ( c_game_map->bounds.h - 2 ) ) )
+  TRACE_SCOPE( "set_tile" );
+  int32_t l_offset = cell_offset( p_location );
+  int32_t l_original = c_overview_map->offset( p_location );
+  int16_t l_id;
+
+  /* A very quick sanity check that we're inside the level! */
+  if ( l_offset < 0 )
   {
     return false;
   }
 
-  /* Relatively simple here, we have four different tiles to set - but RESET */
-  /* is a special case, we have to pick up the original floor tile.          */
-  if ( TILED_RESET == p_type )
+  /* The rules decide what the cell becomes; going back to the original */
+  /* means looking up the block the map has there.                     */
+  uint8_t l_type = rules_cell( c_game_map[l_original], p_type );
+  if ( TILED_RESET == l_type )
   {
-    /* If it was originally a crate, use an empty floor. */
-    if ( TILED_CRATE == at_game_map[c_game_map->offset( p_location )] )
-    {
-      c_game_map->tiles[c_game_map->offset( p_location )] = TILED_EMPTY;
-      c_game_map->tiles[c_game_map->offset( p_location + blit::Point( 1, 0 ) )] = TILED_EMPTY+1;
-      c_game_map->tiles[c_game_map->offset( p_location + blit::Point( 0, 1 ) )] = TILED_EMPTY+16;
-      c_game_map->tiles[c_game_map->offset( p_location + blit::Point( 1, 1 ) )] = TILED_EMPTY+17;
-    }
-    else
-    {
-      /* Just copy the original then. */
-      c_game_map->tiles[c_game_map->offset( p_location )] = at_game_map[c_game_map->offset( p_location )];
-      c_game_map->tiles[c_game_map->offset( p_location + blit::Point( 1, 0 ) )] = at_game_map[c_game_map->offset( p_location + blit::Point( 1, 0 ) )];
-      c_game_map->tiles[c_game_map->offset( p_location + blit::Point( 0, 1 ) )] = at_game_map[c_game_map->offset( p_location + blit::Point( 0, 1 ) )];
-      c_game_map->tiles[c_game_map->offset( p_location + blit::Point( 1, 1 ) )] = at_game_map[c_game_map->offset( p_location + blit::Point( 1, 1 ) )];
-    }
+    l_id = c_metatiles->find( &c_game_map[l_original], c_overview_map->bounds.w );
   }
   else
   {
-    c_game_map->tiles[c_game_map->offset( p_location )] = p_type;
-    c_game_map->tiles[c_game_map->offset( p_location + blit::Point( 1, 0 ) )] = p_type+1;
-    c_game_map->tiles[c_game_map->offset( p_location + blit::Point( 0, 1 ) )] = p_type+16;
-    c_game_map->tiles[c_game_map->offset( p_location + blit::Point( 1, 1 ) )] = p_type+17;
+    l_id = c_metatiles->find( l_type );
+  }
+  if ( l_id < 0 )
+  {
+    return false;
+  }
+
+  /* And then changing it is just the one store. */
+  c_cells[l_offset] = l_id;
+
+  /* Remember where the crates are, for when we come back to this level; */
+  /* if that's a change, let anyone else drawing the map know about it.  */
+  if ( crate_bit( c_cells_level, p_location ) != ( TILED_CRATE == p_type ) )
+  {
+    blit::Point l_local = p_location - level_tile_origin( c_cells_level );
+    tiledelta_t l_delta;
+    l_delta.kind = DELTA_TILE;
+    l_delta.level = c_cells_level;
+    l_delta.x = p_location.x - ( l_local.x % RULES_CELL );
+    l_delta.y = p_location.y - ( l_local.y % RULES_CELL );
+    for ( uint8_t l_corner = 0; l_corner < METATILE_TILES; l_corner++ )
+    {
+      l_delta.tiles[l_corner] = c_metatiles->tile( l_id, l_corner );
+    }
+    g_deltas.push( l_delta );
+
+    set_crate_bit( c_cells_level, p_location, TILED_CRATE == p_type );
   }
 
+  /* The map has changed, so it needs redrawing. */
+  c_revision++;
+
   /* All done. */
   return true;
 }
@@ -249,39 +694,227 @@ bool Game::set_tile( blit::Point p_location, uint8_t p_type )
 
 /*
  * map_transform - callback for the tilemap render, where we apply a suitable
- *                 level of zoom.
+ *                 level of zoom. The transform is the same for every scanline
+ *                 so it's worked out once for each tilemap, in draw_map().
  */
 
 blit::Mat3 Game::map_transform( uint8_t p_scanline )
 {
-  blit::Mat3  l_transform = blit::Mat3::identity();
-  blit::Point l_levelloc = level_centre( g_level );
+  return c_map_matrix;
+}
+
+
+/*
+ * windowed - returns true if a level has to be drawn from a window, rather
+ *            than from the map in flash; that's if any crate has moved.
+ */
+
+bool Game::windowed( uint8_t p_level )
+{
+  return 0 != memcmp( c_crates[p_level], c_initial[p_level], GAME_CRATE_BYTES );
+}
+
 
-  /* Centre things, scaled on zoom. */
-  blit::Vec2 l_centre = blit::Vec2( l_levelloc.x, l_levelloc.y );
+/*
+ * fill_window - fills a window's tiles with the given level as it stands
+ *               now, and a tile all around it; the map in flash, with the
+ *               crates put back where they were left. This is how whoever
+ *               keeps the windows catches up with a level all in one go.
+ */
+
+void Game::fill_window( uint8_t *p_tiles, uint8_t p_level )
+{
+  blit::Point l_origin = level_tile_origin( p_level ) - blit::Point( 1, 1 );
+  blit::Point l_tile;
 
-  /* At a zoom level of 0, this can be a lot simpler. */
-  if ( 0 == c_zoom )
+  /* Start from the map as it was. */
+  for ( uint8_t y = 0; y < LAYOUT_LEVEL_H + 2; y++ )
   {
-    /* Centreing is easy. */
-    l_transform *= blit::Mat3::translation( l_centre );
+    for ( uint8_t x = 0; x < LAYOUT_LEVEL_W + 2; x++ )
+    {
+      p_tiles[x + ( y * GAME_WINDOW_W )] = map_tile( l_origin + blit::Point( x, y ) );
+    }
   }
-  else
+
+  /* And then put the crates where they are now. */
+  for ( uint8_t y = 0; y < GAME_CELLS_H; y++ )
+  {
+    l_tile.y = l_origin.y + 1 + ( y * RULES_CELL );
+    for ( uint8_t x = 0; x < GAME_CELLS_W; x++ )
+    {
+      l_tile.x = l_origin.x + 1 + ( x * RULES_CELL );
+      uint8_t l_original = c_game_map[c_overview_map->offset( l_tile )];
+      bool    l_is_crate = crate_bit( p_level, l_tile );
+      if ( ( TILED_CRATE == l_original ) == l_is_crate )
+      {
+        continue;
+      }
+
+      /* Same rules as set_tile; a crate, or the floor that one has left. */
+      int16_t l_id = c_metatiles->find( rules_cell( l_original, l_is_crate ? TILED_CRATE : TILED_RESET ) );
+      if ( l_id < 0 )
+      {
+        continue;
+      }
+      for ( uint8_t l_corner = 0; l_corner < METATILE_TILES; l_corner++ )
+      {
+        p_tiles[1 + ( x * RULES_CELL ) + ( l_corner % RULES_CELL ) +
+                ( 1 + ( y * RULES_CELL ) + ( l_corner / RULES_CELL ) ) * GAME_WINDOW_W] =
+          c_metatiles->tile( l_id, l_corner );
+      }
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * draw_map - draws a tilemap scaled for the current view into the area of
+ *            the screen given; the offset is where the tilemap starts, in
+ *            world pixels.
+ */
+
+void Game::draw_map( blit::TileMap *p_map, blit::Point p_offset, blit::Rect p_area )
+{
+  /* Nothing to do if it's empty. */
+  if ( p_area.empty() )
+  {
+    return;
+  }
+
+  /* The scanline callback hands out the matrix, so set that up first. */
+  c_map_matrix = map_matrix( c_view, p_offset );
+  TRACE_BEGIN( "TileMap::draw" );
+  g_renderpool.draw( p_map, &blit::screen, p_area, c_map_scanline );
+  TRACE_END( "TileMap::draw" );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * draw_level - draws the current level directly from the spritesheet, cell by
+ *              cell; only valid when we're fully zoomed in, when the map is
+ *              neither scaled nor offset by anything but whole tiles. Most
+ *              cells are a single 16x16 block of the sheet, and any that
+ *              aren't are drawn a tile at a time.
+ */
+
+void Game::draw_level( void )
+{
+  blit::Point l_dest;
+
+  /* The level fills the screen, so just walk through every cell. */
+  for ( uint8_t y = 0; y < GAME_CELLS_H; y++ )
   {
-    /* Centre has to reflect the zoom level. */
-    l_centre += ( blit::Vec2( 800, 600 ) - l_centre ) * c_zoom / 100.0f;
-    l_transform *= blit::Mat3::translation( l_centre );
+    l_dest.y = y * GAME_CELL_SIZE;
+    for ( uint8_t x = 0; x < GAME_CELLS_W; x++ )
+    {
+      uint8_t l_id = c_cells[x + ( y * GAME_CELLS_W )];
+      l_dest.x = x * GAME_CELL_SIZE;
 
-    /* Then work out the scale vector, based on the current zoom percentage. */
-    float l_scale = 1.0f + ( c_zoom / 25.0f );
-    l_transform *= blit::Mat3::scale( blit::Vec2( l_scale, l_scale ) );
+      if ( c_metatiles->block( l_id ) )
+      {
+        uint8_t l_type = c_metatiles->type( l_id );
+        c_game_sheet->sprite( blit::Rect( l_type % METATILE_SHEET_W, l_type / METATILE_SHEET_W, RULES_CELL, RULES_CELL ),
+                              l_dest );
+        continue;
+      }
+
+      for ( uint8_t l_corner = 0; l_corner < METATILE_TILES; l_corner++ )
+      {
+        c_game_sheet->tile( c_metatiles->tile( l_id, l_corner ),
+                            l_dest + blit::Point( ( l_corner % RULES_CELL ) * SHEET_TILE_SIZE,
+                                                  ( l_corner / RULES_CELL ) * SHEET_TILE_SIZE ) );
+      }
+    }
   }
 
-  /* Lastly, transform to the centre of the screen. */
-  l_transform *= blit::Mat3::translation( blit::Vec2( blit::screen.bounds.w / 2 * -1, blit::screen.bounds.h / 2 * -1 ) );
+  /* All done. */
+  return;
+}
+
+
+/*
+ * draw_overview - draws the map scaled, for when we're not fully zoomed in;
+ *                 most of it comes straight from flash, but any level where
+ *                 crates have moved is drawn from the window the menu keeps
+ *                 for it instead, so
+ *                 that progress on every level shows. Each pixel
+ *                 is only drawn the once, so that fading doesn't let the
+ *                 map in flash show through.
+ */
+
+void Game::draw_overview( Menu *p_menu )
+{
+  blit::Rect l_clip = blit::screen.clip;
+  int32_t    l_band = l_clip.y;
+
+  /* The levels sit on a grid, so work down it a row at a time; rows with */
+  /* nothing changed in them are left to be drawn in one band later.     */
+  for ( uint8_t l_row = 0; l_row < LAYOUT_GRID_H; l_row++ )
+  {
+    blit::Rect l_row_area = map_area( c_view, blit::Rect( 0, l_row * LAYOUT_LEVEL_H * LAYOUT_TILE_SIZE,
+                                                          LAYOUT_GRID_W * LAYOUT_LEVEL_W * LAYOUT_TILE_SIZE,
+                                                          LAYOUT_LEVEL_H * LAYOUT_TILE_SIZE ) ).intersection( l_clip );
+    int32_t    l_left = l_clip.x;
+    bool       l_split = false;
 
-  /* Return the transform we've ended up with. */
-  return l_transform;
+    if ( l_row_area.empty() )
+    {
+      continue;
+    }
+
+    /* Levels are numbered across each row, so they come left to right. */
+    for ( uint8_t l_level = 1; l_level <= LAYOUT_LEVELS; l_level++ )
+    {
+      blit::Point l_origin = level_tile_origin( l_level );
+      if ( l_origin.y != l_row * LAYOUT_LEVEL_H )
+      {
+        continue;
+      }
+      blit::Rect l_area = map_area( c_view, blit::Rect( l_origin * LAYOUT_TILE_SIZE,
+                                                        blit::Size( LAYOUT_LEVEL_W * LAYOUT_TILE_SIZE,
+                                                                    LAYOUT_LEVEL_H * LAYOUT_TILE_SIZE ) ) ).intersection( l_row_area );
+      blit::TileMap *l_window = ( l_area.empty() || ( nullptr == p_menu ) ) ? nullptr : p_menu->level_map( l_level );
+      if ( nullptr == l_window )
+      {
+        continue;
+      }
+
+      /* The first change in a row means drawing the band above it. */
+      if ( !l_split )
+      {
+        draw_map( c_overview_map, blit::Point( 0, 0 ),
+                  blit::Rect( l_clip.x, l_band, l_clip.w, l_row_area.y - l_band ) );
+        l_split = true;
+      }
+
+      /* Then the map up to the level, and the level from its window. */
+      draw_map( c_overview_map, blit::Point( 0, 0 ),
+                blit::Rect( l_left, l_row_area.y, l_area.x - l_left, l_row_area.h ) );
+      draw_map( l_window, ( l_origin - blit::Point( 1, 1 ) ) * LAYOUT_TILE_SIZE, l_area );
+      l_left = l_area.x + l_area.w;
+    }
+
+    /* If the row was split up, finish it off and start a new band. */
+    if ( l_split )
+    {
+      draw_map( c_overview_map, blit::Point( 0, 0 ),
+                blit::Rect( l_left, l_row_area.y, l_clip.x + l_clip.w - l_left, l_row_area.h ) );
+      l_band = l_row_area.y + l_row_area.h;
+    }
+  }
+
+  /* And then whatever is left at the bottom. */
+  draw_map( c_overview_map, blit::Point( 0, 0 ),
+            blit::Rect( l_clip.x, l_band, l_clip.w, l_clip.y + l_clip.h - l_band ) );
+
+  /* All done. */
+  return;
 }
 
 
@@ -291,6 +924,7 @@ blit::Mat3 Game::map_transform( uint8_t p_scanline )
 
 void Game::update( uint32_t p_time )
 {
+  TRACE_SCOPE( "Game::update" );
   direction_t l_move = DIR_NONE;
 
   /* We only respond to user input when we're fully zoomed. */
@@ -299,10 +933,26 @@ void Game::update( uint32_t p_time )
     return;
   }
 
-  /* Need to keep the player updating. */
-  bool l_was_moving = c_player[g_level]->moving();
+  /* Make sure the cells are holding the right level. */
+  if ( c_cells_level != g_level )
+  {
+    fill_cells( g_level );
+  }
+
+  /* Any input that has just stopped a demo goes no further. */
+  bool l_input = !g_attract.swallowed();
+
+  /* Y restarts the level, wherever we are in it. */
+  if ( l_input && ( blit::buttons.pressed & blit::Button::Y ) )
+  {
+    restart_level( g_level );
+    return;
+  }
+
+  /* Need to keep the player updating; the pushing flag outlives the move */
+  /* itself until this update, so it tells us if a push has just ended.   */
   bool l_was_pushing = c_player[g_level]->pushing();
-  c_player[g_level]->update();
+  c_player[g_level]->update( p_time );
 
   /* We only pay attention to movement commands when the player isn't already */
   /* in motion - otherwise things will get ... confusing.                     */
@@ -313,86 +963,70 @@ void Game::update( uint32_t p_time )
 
   /* If we have just finished moving, and we were pushing a crate, we need */
   /* to park it where it was going...                                      */
-  if ( l_was_moving && l_was_pushing )
+  if ( l_was_pushing )
   {
-    blit::Point l_crate = level_tile_origin( g_level ) + c_player[g_level]->location();
-    switch( c_player[g_level]->facing() )
-    {
-      case DIR_LEFT:
-        l_crate -= blit::Point( 2, 0 );
-        break;
-      case DIR_RIGHT:
-        l_crate += blit::Point( 2, 0 );
-        break;
-      case DIR_UP:
-        l_crate -= blit::Point( 0, 2 );
-        break;
-      case DIR_DOWN:
-        l_crate += blit::Point( 0, 2 );
-        break;
-    }
-    set_tile( l_crate, TILED_CRATE );
+    int8_t l_dx, l_dy;
+    rules_step( c_player[g_level]->facing(), &l_dx, &l_dy );
+    set_tile( level_tile_origin( g_level ) + c_player[g_level]->location() + blit::Point( l_dx, l_dy ),
+              TILED_CRATE );
   }
 
-  /* So, find out what direction the player wants to go. */
+  /* So, find out what direction the player wants to go; during a demo, */
+  /* the attract mode decides that for them.                            */
   blit::Point l_location = level_tile_origin( g_level ) + c_player[g_level]->location();
   blit::Point l_target, l_crate_target;
 
-  if ( ( blit::pressed( blit::Button::DPAD_LEFT ) ) || ( blit::joystick.x < -0.3f ) )
-  {
-    l_move = DIR_LEFT;
-    l_target = l_location - blit::Point( 2, 0 );
-    l_crate_target = l_location - blit::Point( 4, 0 );
-  }
-  if ( ( blit::pressed( blit::Button::DPAD_RIGHT ) ) || ( blit::joystick.x > 0.3f ) )
+  if ( g_attract.playing() )
   {
-    l_move = DIR_RIGHT;
-    l_target = l_location + blit::Point( 2, 0 );
-    l_crate_target = l_location + blit::Point( 4, 0 );
+    l_move = g_attract.next_move();
   }
-  if ( ( blit::pressed( blit::Button::DPAD_UP ) ) || ( blit::joystick.y < -0.3f ) )
+  else if ( l_input )
   {
-    l_move = DIR_UP;
-    l_target = l_location - blit::Point( 0, 2 );
-    l_crate_target = l_location - blit::Point( 0, 4 );
-  }
-  if ( ( blit::pressed( blit::Button::DPAD_DOWN ) ) || ( blit::joystick.y > 0.3f ) )
-  {
-    l_move = DIR_DOWN;
-    l_target = l_location + blit::Point( 0, 2 );
-    l_crate_target = l_location + blit::Point( 0, 4 );
+    if ( ( blit::pressed( blit::Button::DPAD_LEFT ) ) || ( blit::joystick.x < -0.3f ) )
+    {
+      l_move = DIR_LEFT;
+    }
+    if ( ( blit::pressed( blit::Button::DPAD_RIGHT ) ) || ( blit::joystick.x > 0.3f ) )
+    {
+      l_move = DIR_RIGHT;
+    }
+    if ( ( blit::pressed( blit::Button::DPAD_UP ) ) || ( blit::joystick.y < -0.3f ) )
+    {
+      l_move = DIR_UP;
+    }
+    if ( ( blit::pressed( blit::Button::DPAD_DOWN ) ) || ( blit::joystick.y > 0.3f ) )
+    {
+      l_move = DIR_DOWN;
+    }
   }
 
   /* Ask the player to do that move, then. */
   if ( DIR_NONE != l_move )
   {
-    /* Look at the destinations, work out the various flags. */
-    bool l_blocked = false;
-    bool l_pushing = false;
+    /* Look at the cell we're moving into, and the one beyond it. */
+    bool   l_blocked = false;
+    bool   l_pushing = false;
+    int8_t l_dx, l_dy;
 
-    /* Is our move target a wall? */
-    uint8_t l_target_tile = c_game_map->tile_at( l_target );
-    if ( TILED_WALL == l_target_tile )
-    {
-      l_blocked = true;
-    }
-    else if ( TILED_CRATE == l_target_tile )
+    rules_step( l_move, &l_dx, &l_dy );
+    l_target = l_location + blit::Point( l_dx, l_dy );
+    l_crate_target = l_target + blit::Point( l_dx, l_dy );
+
+    switch( rules_check( get_tile( l_target ), get_tile( l_crate_target ) ) )
     {
-      /* If it's a crate we need to work out if *that* moves into free space. */
-      uint8_t l_crate_tile = c_game_map->tile_at( l_crate_target );
-      if ( ( TILED_WALL == l_crate_tile ) || ( TILED_CRATE == l_crate_tile ) )
-      {
-        /* It's like walking into a wall. */
+      case RULE_BLOCKED:
         l_blocked = true;
-      }
-      else
-      {
-        /* Update the underlying tilemap to reflect that the crate has moved. */
-        set_tile( l_target, TILED_RESET );
+        break;
 
-        /* Flag that we're also pushing a crate. */
+      case RULE_PUSH:
+        /* Update the underlying tilemap to reflect that the crate has moved, */
+        /* and flag that we're also pushing a crate.                          */
+        set_tile( l_target, TILED_RESET );
         l_pushing = true;
-      }
+        break;
+
+      case RULE_WALK:
+        break;
     }
 
     /* And finally, ask the player to move herself. */
@@ -409,26 +1043,47 @@ void Game::update( uint32_t p_time )
  *          the zoom factor is used for the transitioning from game to game, and back.
  */
 
-void Game::render( uint32_t p_time, uint8_t p_zoom )
+void Game::render( uint32_t p_time, uint8_t p_zoom, Menu *p_menu )
 {
   /* Save the zoom factor, making sure it's a sensible value. */
   c_zoom = ( p_zoom > 100 ) ? 100 : p_zoom;
 
-  /* Set the alpha for all of this depending on the zoom. */
+  /* Make sure the cells are holding the right level. */
+  if ( c_cells_level != g_level )
+  {
+    fill_cells( g_level );
+  }
+
+  /* Work out the view once for the frame; each tilemap drawn with it */
+  /* works out its own transform.                                     */
+  c_view = map_view( g_level, c_zoom );
+
+  /* Set the alpha for all of this depending on the zoom; if we're short  */
+  /* of time, the governor may decide we can't afford to fade things.    */
   uint8_t l_previous_alpha = blit::screen.alpha;
-  blit::screen.alpha = 255 - ( c_zoom * 1.5 );
+  blit::screen.alpha = g_governor.fade( 255 - ( c_zoom * 1.5 ), QUALITY_NO_FADES );
 
-  /* Ask the base tilemap to draw itself, as a suitble zoom & alpha. */
-  if ( nullptr != c_game_map )
+  /* When we're fully zoomed in, the level fills the screen and can be   */
+  /* drawn straight from the cells; otherwise, it's the map scaled, with  */
+  /* any changed level swapped in from its window.                       */
+  if ( ( 0 == c_zoom ) && ( 1 == render_scale() ) )
+  {
+    draw_level();
+  }
+  else if ( nullptr != c_overview_map )
   {
-    c_game_map->draw( &blit::screen, blit::screen.clip, std::bind( &Game::map_transform, this, std::placeholders::_1 ) );
+    draw_overview( p_menu );
   }
 
   /* We only draw the more dynamic elements when we're full sized. */
-  if ( 0 == c_zoom )
+  if ( ( 0 == c_zoom ) && ( 1 == render_scale() ) )
   {
-    /* Drop in the player for the current level. */
-    c_player[g_level]->render();
+    /* Collect up all the sprites, draw them in one go, and then add */
+    /* the player's status over the top of it all.                   */
+    c_batch.begin( c_game_sheet );
+    c_player[g_level]->render( &c_batch );
+    c_batch.flush();
+    c_player[g_level]->render_status();
   }
 
   /* Reset the alpha to what it was before. */
@@ -14,28 +14,99 @@
 
 #include "32blit.hpp"
 #include "sokoblit.hpp"
+#include "Geometry.hpp"
+#include "LevelPack.hpp"
+#include "Metatile.hpp"
 #include "Player.hpp"
+#include "RenderPool.hpp"
+#include "SpriteBatch.hpp"
+#include "SpriteSheet.hpp"
+
+/* Only the current level is held in RAM, as one metatile per (2x2) cell; */
+/* everything around it is drawn straight from the map in flash.          */
+
+#define GAME_CELLS_W        ( LAYOUT_LEVEL_W / RULES_CELL )
+#define GAME_CELLS_H        ( LAYOUT_LEVEL_H / RULES_CELL )
+#define GAME_CELL_SIZE      ( RULES_CELL * SHEET_TILE_SIZE )
+
+/* A level that has changed is drawn scaled from a window of tiles around  */
+/* it, one tile bigger on each side; tilemaps need power of two sizes. The */
+/* menu keeps the windows, in step with the game through tile deltas.      */
+
+#define GAME_WINDOW_W       64
+#define GAME_WINDOW_H       32
+
+/* Progress on every level is kept as one bit per cell for crates. */
+
+#define GAME_CRATE_BYTES    ( ( GAME_CELLS_W * GAME_CELLS_H + 7 ) / 8 )
+
+typedef enum
+{
+  LOAD_SPRITES,
+  LOAD_MAP,
+  LOAD_LEVELS,
+  LOAD_PACK,
+  LOAD_DONE,
+  LOAD_FAILED
+} loadstate_t;
+
+class Menu;
 
 class Game
 {
   private:
     uint8_t         c_zoom;
+    loadstate_t     c_loadstate;
+    uint32_t        c_phase_start;
+    uint8_t         c_loadlevel;
+    uint32_t        c_revision;
     blit::Surface  *c_game_sprites;
-    blit::TileMap  *c_game_map;
-    uint8_t        *c_game_tiles;
+    SpriteSheet    *c_game_sheet;
+    const uint8_t  *c_game_map;
+    blit::TileMap  *c_overview_map;
+    MetatileSet    *c_metatiles;
+    uint8_t        *c_cells;
+    uint8_t         c_cells_level;
+    SpriteBatch     c_batch;
+    mapview_t       c_view;
+    blit::Mat3      c_map_matrix;
+    scanline_t      c_map_scanline;
+    uint8_t         c_crates[SOKOBLIT_LEVEL_MAX+1][GAME_CRATE_BYTES];
+    uint8_t         c_initial[SOKOBLIT_LEVEL_MAX+1][GAME_CRATE_BYTES];
+    blit::Font     *c_font;
+    LevelPack      *c_pack;
 
     Player         *c_player[SOKOBLIT_LEVEL_MAX+1];
 
-    blit::Rect      level_rect( uint8_t );
-    blit::Point     level_tile_origin( uint8_t );
+    int32_t         cell_offset( blit::Point );
+    void            fill_cells( uint8_t );
+    bool            crate_bit( uint8_t, blit::Point );
+    void            set_crate_bit( uint8_t, blit::Point, bool );
+    uint8_t         get_tile( blit::Point );
     bool            set_tile( blit::Point, uint8_t );
+    bool            load_level( uint8_t );
+    bool            load_failed( const char * );
+    uint8_t         map_tile( blit::Point );
+    void            draw_map( blit::TileMap *, blit::Point, blit::Rect );
+    void            draw_level( void );
+    void            draw_overview( Menu * );
 
   public:
                     Game( void );
                    ~Game( void );
+    bool            load( void );
+    bool            ready( void );
+    LevelPack      *pack( void );
+    blit::Surface  *sprites( void );
+    uint32_t        signature( void );
+    bool            untouched( uint8_t );
+    bool            solved( uint8_t );
+    void            restart_level( uint8_t );
+    bool            windowed( uint8_t );
+    void            fill_window( uint8_t *, uint8_t );
     blit::Mat3      map_transform( uint8_t );
     void            update( uint32_t );
-    void            render( uint32_t, uint8_t );
+    void            render( uint32_t, uint8_t, Menu * );
 };
 
 #endif /* _GAME_HPP_ */
@@ -0,0 +1,228 @@
+/*
+ * Geometry.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Fixed point (16.16) geometry shared by the menu and the game; the view of
+ * the map for any level and zoom, the transform the tilemaps are drawn with,
+ * and where a chunk of the world ends up on screen. The zoom factors are all
+ * looked up from tables, so there's no division to do at runtime.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Geometry.hpp"
+
+
+/* Module variables. */
+
+static fixed_t g_zoom_scale[GEOMETRY_ZOOM_MAX+1];
+static fixed_t g_zoom_inverse[GEOMETRY_ZOOM_MAX+1];
+static fixed_t g_zoom_fraction[GEOMETRY_ZOOM_MAX+1];
+
+
+/* Functions. */
+
+/*
+ * geometry_init - fills in the zoom tables; at zoom z the map is scaled by
+ *                 ( 1 + z/25 ), and the view centre has moved z% of the way
+ *                 from the level to the middle of the map.
+ */
+
+void geometry_init( void )
+{
+  for ( uint8_t l_zoom = 0; l_zoom <= GEOMETRY_ZOOM_MAX; l_zoom++ )
+  {
+    /* Work in whole numbers, rounding to the nearest fixed point value; */
+    /* except the inverse, which rounds up so that sizes which divide   */
+    /* exactly don't come out a pixel short when floored.               */
+    g_zoom_scale[l_zoom] = ( FIXED_ONE * ( 25 + l_zoom ) + 12 ) / 25;
+    g_zoom_inverse[l_zoom] = ( FIXED_ONE * 25 + 24 + l_zoom ) / ( 25 + l_zoom );
+    g_zoom_fraction[l_zoom] = ( FIXED_ONE * l_zoom + 50 ) / 100;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * zoom_inverse - returns the inverse of the scale at the given zoom.
+ */
+
+fixed_t zoom_inverse( uint8_t p_zoom )
+{
+  return g_zoom_inverse[p_zoom > GEOMETRY_ZOOM_MAX ? GEOMETRY_ZOOM_MAX : p_zoom];
+}
+
+
+/*
+ * zoom_fraction - returns how far through the zoom we are, from 0 to 1.
+ */
+
+fixed_t zoom_fraction( uint8_t p_zoom )
+{
+  return g_zoom_fraction[p_zoom > GEOMETRY_ZOOM_MAX ? GEOMETRY_ZOOM_MAX : p_zoom];
+}
+
+
+/*
+ * map_view - works out the view of the map for a given level and zoom; the
+ *            scale includes any drop down to lores.
+ */
+
+mapview_t map_view( uint8_t p_level, uint8_t p_zoom )
+{
+  mapview_t   l_view;
+  blit::Point l_levelloc = level_centre( p_level );
+  uint8_t     l_zoom = ( p_zoom > GEOMETRY_ZOOM_MAX ) ? GEOMETRY_ZOOM_MAX : p_zoom;
+
+  /* Centre moves towards the middle of the map as we zoom out. */
+  l_view.x = FIXED_INT( l_levelloc.x ) +
+             ( ( SOKOBLIT_WORLD_W * LAYOUT_GRID_W / 2 ) - l_levelloc.x ) * g_zoom_fraction[l_zoom];
+  l_view.y = FIXED_INT( l_levelloc.y ) +
+             ( ( SOKOBLIT_WORLD_H * LAYOUT_GRID_H / 2 ) - l_levelloc.y ) * g_zoom_fraction[l_zoom];
+
+  /* And the scale is straight from the tables. */
+  l_view.scale = g_zoom_scale[l_zoom] * render_scale();
+  l_view.inverse = g_zoom_inverse[l_zoom] / render_scale();
+
+  /* All done. */
+  return l_view;
+}
+
+
+/*
+ * map_matrix - builds the transform a tilemap is drawn with, for the view
+ *              given; the offset shifts it for maps which don't start at the
+ *              world origin. The screen centre maps to the view centre.
+ */
+
+blit::Mat3 map_matrix( const mapview_t &p_view, blit::Point p_offset )
+{
+  blit::Mat3 l_transform = blit::Mat3::identity();
+
+  /* It's only ever a scale and a translation, so just fill those in. */
+  l_transform.v00 = FIXED_FLOAT( p_view.scale );
+  l_transform.v11 = FIXED_FLOAT( p_view.scale );
+  l_transform.v02 = FIXED_FLOAT( p_view.x - p_view.scale * ( blit::screen.bounds.w / 2 ) - FIXED_INT( p_offset.x ) );
+  l_transform.v12 = FIXED_FLOAT( p_view.y - p_view.scale * ( blit::screen.bounds.h / 2 ) - FIXED_INT( p_offset.y ) );
+
+  /* All done. */
+  return l_transform;
+}
+
+
+/*
+ * map_rect - works out where a Rect in the world ends up on screen, for the
+ *            view given; rounded outwards so that it covers every pixel the
+ *            world Rect touches.
+ */
+
+blit::Rect map_rect( const mapview_t &p_view, blit::Rect p_world )
+{
+  fixed_t l_left, l_top, l_right, l_bottom;
+
+  /* Run the corners through the view. */
+  l_left = fixed_mul( FIXED_INT( p_world.x ) - p_view.x, p_view.inverse ) + FIXED_INT( blit::screen.bounds.w / 2 );
+  l_top = fixed_mul( FIXED_INT( p_world.y ) - p_view.y, p_view.inverse ) + FIXED_INT( blit::screen.bounds.h / 2 );
+  l_right = l_left + p_world.w * p_view.inverse;
+  l_bottom = l_top + p_world.h * p_view.inverse;
+
+  /* All done. */
+  return blit::Rect( FIXED_FLOOR( l_left ), FIXED_FLOOR( l_top ),
+                     FIXED_CEIL( l_right ) - FIXED_FLOOR( l_left ),
+                     FIXED_CEIL( l_bottom ) - FIXED_FLOOR( l_top ) );
+}
+
+
+/*
+ * map_area - works out which screen pixels a tilemap drawn with the view
+ *            given takes from a Rect in the world; unlike map_rect, areas
+ *            worked out for neighbouring Rects never share a pixel.
+ */
+
+blit::Rect map_area( const mapview_t &p_view, blit::Rect p_world )
+{
+  fixed_t l_left, l_top, l_right, l_bottom;
+
+  /* A pixel belongs to whichever Rect its top left corner lands in; each */
+  /* edge is worked out the same way, so that shared edges agree exactly.  */
+  l_left = fixed_mul( FIXED_INT( p_world.x ) - p_view.x, p_view.inverse ) + FIXED_INT( blit::screen.bounds.w / 2 );
+  l_top = fixed_mul( FIXED_INT( p_world.y ) - p_view.y, p_view.inverse ) + FIXED_INT( blit::screen.bounds.h / 2 );
+  l_right = fixed_mul( FIXED_INT( p_world.x + p_world.w ) - p_view.x, p_view.inverse ) +
+            FIXED_INT( blit::screen.bounds.w / 2 );
+  l_bottom = fixed_mul( FIXED_INT( p_world.y + p_world.h ) - p_view.y, p_view.inverse ) +
+             FIXED_INT( blit::screen.bounds.h / 2 );
+
+  /* All done. */
+  return blit::Rect( FIXED_CEIL( l_left ), FIXED_CEIL( l_top ),
+                     FIXED_CEIL( l_right ) - FIXED_CEIL( l_left ),
+                     FIXED_CEIL( l_bottom ) - FIXED_CEIL( l_top ) );
+}
+
+
+/*
+ * geometry_benchmark - compares building the tilemap transform the old way,
+ *                      in floats on every scanline, with building it once a
+ *                      frame from the tables. Only built in when benchmarks
+ *                      are asked for.
+ */
+
+void geometry_benchmark( void )
+{
+#ifdef SOKOBLIT_BENCHMARK
+  const uint16_t  l_frames = 100;
+  uint32_t        l_start, l_float_us, l_fixed_us;
+  volatile float  l_sink = 0.0f;
+
+  /* The old way; a full float transform chain for every scanline. */
+  l_start = blit::now_us();
+  for ( uint16_t l_frame = 0; l_frame < l_frames; l_frame++ )
+  {
+    uint8_t l_zoom = l_frame % ( GEOMETRY_ZOOM_MAX + 1 );
+    for ( int16_t l_scanline = 0; l_scanline < blit::screen.bounds.h; l_scanline++ )
+    {
+      blit::Point l_levelloc = level_centre( 1 + ( l_frame % SOKOBLIT_LEVEL_MAX ) );
+      blit::Vec2  l_centre = blit::Vec2( l_levelloc.x, l_levelloc.y );
+      blit::Mat3  l_transform = blit::Mat3::identity();
+
+      l_centre += ( blit::Vec2( 800, 600 ) - l_centre ) * l_zoom / 100.0f;
+      l_transform *= blit::Mat3::translation( l_centre );
+      float l_scale = ( 1.0f + ( l_zoom / 25.0f ) ) * render_scale();
+      l_transform *= blit::Mat3::scale( blit::Vec2( l_scale, l_scale ) );
+      l_transform *= blit::Mat3::translation( blit::Vec2( blit::screen.bounds.w / 2 * -1, blit::screen.bounds.h / 2 * -1 ) );
+      l_sink = l_sink + l_transform.v02;
+    }
+  }
+  l_float_us = blit::us_diff( l_start, blit::now_us() );
+
+  /* The new way; one fixed point view and matrix a frame. */
+  l_start = blit::now_us();
+  for ( uint16_t l_frame = 0; l_frame < l_frames; l_frame++ )
+  {
+    mapview_t  l_view = map_view( 1 + ( l_frame % SOKOBLIT_LEVEL_MAX ), l_frame % ( GEOMETRY_ZOOM_MAX + 1 ) );
+    blit::Mat3 l_transform = map_matrix( l_view, blit::Point( 0, 0 ) );
+    l_sink = l_sink + l_transform.v02;
+  }
+  l_fixed_us = blit::us_diff( l_start, blit::now_us() );
+
+  /* And report what we found, per frame. */
+  blit::debugf( "bench: transform float %lu us/frame, fixed %lu us/frame\n",
+                (unsigned long)( l_float_us / l_frames ), (unsigned long)( l_fixed_us / l_frames ) );
+#endif /* SOKOBLIT_BENCHMARK */
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file Geometry.cpp */
@@ -0,0 +1,57 @@
+/*
+ * Geometry.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Fixed point (16.16) geometry shared by the menu and the game; the view of
+ * the map for any level and zoom, the transform the tilemaps are drawn with,
+ * and where a chunk of the world ends up on screen. The zoom factors are all
+ * looked up from tables, so there's no division to do at runtime.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _GEOMETRY_HPP_
+#define   _GEOMETRY_HPP_
+
+#include "32blit.hpp"
+
+#define FIXED_SHIFT         16
+#define FIXED_ONE           ( 1 << FIXED_SHIFT )
+#define FIXED_INT(i)        ( (fixed_t)(i) * FIXED_ONE )
+#define FIXED_FLOOR(f)      ( (f) >> FIXED_SHIFT )
+#define FIXED_CEIL(f)       ( ( (f) + FIXED_ONE - 1 ) >> FIXED_SHIFT )
+#define FIXED_FLOAT(f)      ( (float)(f) / FIXED_ONE )
+
+#define GEOMETRY_ZOOM_MAX   100
+
+typedef int32_t fixed_t;
+
+/* A view of the map; the world point at the centre of the screen, and the */
+/* number of world pixels per screen pixel (plus the inverse of that).     */
+
+typedef struct
+{
+  fixed_t   x;
+  fixed_t   y;
+  fixed_t   scale;
+  fixed_t   inverse;
+} mapview_t;
+
+inline fixed_t fixed_mul( fixed_t p_a, fixed_t p_b )
+{
+  return (fixed_t)( ( (int64_t)p_a * p_b ) >> FIXED_SHIFT );
+}
+
+void        geometry_init( void );
+fixed_t     zoom_inverse( uint8_t );
+fixed_t     zoom_fraction( uint8_t );
+mapview_t   map_view( uint8_t, uint8_t );
+blit::Mat3  map_matrix( const mapview_t &, blit::Point );
+blit::Rect  map_rect( const mapview_t &, blit::Rect );
+blit::Rect  map_area( const mapview_t &, blit::Rect );
+void        geometry_benchmark( void );
+
+#endif /* _GEOMETRY_HPP_ */
+
+/* End of file Geometry.hpp */
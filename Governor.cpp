@@ -0,0 +1,154 @@
+/*
+ * Governor.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The Governor keeps an eye on how long each frame takes to render, and if
+ * we're consistently over budget it steps down the quality of the effects
+ * we draw; when there's room to spare again, it steps them back up.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstring>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Governor.hpp"
+
+
+/* Module variables. */
+
+Governor g_governor( GOVERNOR_BUDGET_US );
+
+static const char *g_quality_names[QUALITY_MAX] =
+{
+  "full", "solid splash", "still pulse", "no fades"
+};
+
+
+/* Functions. */
+
+/*
+ * Governor - constructor, which takes the render budget in microseconds.
+ */
+
+Governor::Governor( uint32_t p_budget )
+{
+  /* Start with an empty window, at full quality. */
+  c_budget = p_budget;
+  memset( c_samples, 0, sizeof( c_samples ) );
+  c_total = 0;
+  c_next = 0;
+  c_count = 0;
+  c_settle = 0;
+  c_tier = QUALITY_FULL;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * record - adds the time of the latest render to the sliding window, and
+ *          decides if we need to change tier. After any change we wait for
+ *          a whole window of new samples before judging again.
+ */
+
+void Governor::record( uint32_t p_time )
+{
+  /* Swap the oldest sample out of the running total. */
+  c_total -= c_samples[c_next];
+  c_samples[c_next] = p_time;
+  c_total += p_time;
+  c_next = ( c_next + 1 ) % GOVERNOR_WINDOW;
+  if ( c_count < GOVERNOR_WINDOW )
+  {
+    c_count++;
+  }
+
+  /* Don't judge anything until we've seen enough of the current tier. */
+  if ( c_settle > 0 )
+  {
+    c_settle--;
+    return;
+  }
+  if ( c_count < GOVERNOR_WINDOW )
+  {
+    return;
+  }
+
+  /* Over budget means dropping something, if we can. */
+  quality_t l_tier = c_tier;
+  if ( ( average() > c_budget ) && ( c_tier < ( QUALITY_MAX - 1 ) ) )
+  {
+    l_tier = (quality_t)( c_tier + 1 );
+  }
+
+  /* And plenty of headroom means we can afford to put it back. */
+  if ( ( average() < ( c_budget * GOVERNOR_HEADROOM / 100 ) ) && ( c_tier > QUALITY_FULL ) )
+  {
+    l_tier = (quality_t)( c_tier - 1 );
+  }
+
+  /* If we changed, say so and give it time to take effect. */
+  if ( l_tier != c_tier )
+  {
+    blit::debugf( "Governor: %lu us average, quality now %s\n",
+                  (unsigned long)average(), g_quality_names[l_tier] );
+    c_tier = l_tier;
+    c_settle = GOVERNOR_WINDOW;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * average - returns the average render time over the window.
+ */
+
+uint32_t Governor::average( void )
+{
+  return ( c_count > 0 ) ? ( c_total / c_count ) : 0;
+}
+
+
+/*
+ * tier - returns the quality tier we're currently running at.
+ */
+
+quality_t Governor::tier( void )
+{
+  /* Simple access method. */
+  return c_tier;
+}
+
+
+/*
+ * fade - filters an alpha value for an effect that is dropped at the given
+ *        tier; once we're there, anything visible is drawn fully opaque so
+ *        that we skip the blending entirely.
+ */
+
+uint8_t Governor::fade( uint8_t p_alpha, quality_t p_tier )
+{
+  /* If we're not degrading this, it's left alone. */
+  if ( c_tier < p_tier )
+  {
+    return p_alpha;
+  }
+
+  /* Otherwise, it's all or nothing. */
+  return ( 0 == p_alpha ) ? 0 : 255;
+}
+
+
+/* End of file Governor.cpp */
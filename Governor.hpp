@@ -0,0 +1,56 @@
+/*
+ * Governor.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The Governor keeps an eye on how long each frame takes to render, and if
+ * we're consistently over budget it steps down the quality of the effects
+ * we draw; when there's room to spare again, it steps them back up.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _GOVERNOR_HPP_
+#define   _GOVERNOR_HPP_
+
+#include "32blit.hpp"
+
+#define GOVERNOR_WINDOW     16
+#define GOVERNOR_BUDGET_US  16000
+#define GOVERNOR_HEADROOM   60      /* percentage of budget to step back up */
+
+/* Quality tiers, each one dropping a little more than the last. */
+
+typedef enum
+{
+  QUALITY_FULL,
+  QUALITY_SOLID_SPLASH,
+  QUALITY_STILL_PULSE,
+  QUALITY_NO_FADES,
+  QUALITY_MAX
+} quality_t;
+
+class Governor
+{
+  private:
+    uint32_t        c_budget;
+    uint32_t        c_samples[GOVERNOR_WINDOW];
+    uint32_t        c_total;
+    uint8_t         c_next;
+    uint8_t         c_count;
+    uint8_t         c_settle;
+    quality_t       c_tier;
+
+  public:
+                    Governor( uint32_t );
+    void            record( uint32_t );
+    uint32_t        average( void );
+    quality_t       tier( void );
+    uint8_t         fade( uint8_t, quality_t );
+};
+
+extern Governor g_governor;
+
+#endif /* _GOVERNOR_HPP_ */
+
+/* End of file Governor.hpp */
@@ -0,0 +1,189 @@
+/*
+ * Layout.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Describes how the levels are laid out on the map; everything else - where
+ * each level starts, where its centre is, and which level is next to it in
+ * each direction - is worked out from that at compile time, so lookups are
+ * just an index into a table.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _LAYOUT_HPP_
+#define   _LAYOUT_HPP_
+
+#include "32blit.hpp"
+
+/* Each level is a screen's worth of 8x8 tiles. */
+
+#define LAYOUT_LEVEL_W      40
+#define LAYOUT_LEVEL_H      30
+#define LAYOUT_TILE_SIZE    8
+#define LAYOUT_NONE         0
+
+/* The map itself, one character per level-sized slot; a '#' is a level and */
+/* anything else is a gap. Levels are numbered from 1, reading across and    */
+/* then down; change this (and the map!) to change the levels.               */
+
+#define LAYOUT_GRID_W       5
+#define LAYOUT_GRID_H       5
+
+constexpr char g_layout_grid[LAYOUT_GRID_H][LAYOUT_GRID_W + 1] =
+{
+  "#####",
+  "#####",
+  "#...#",
+  "#####",
+  "#####"
+};
+
+/* Everything we need to know about a single level. */
+
+typedef struct
+{
+  int16_t         tile_x;           /* origin on the map, in tiles */
+  int16_t         tile_y;
+  int16_t         centre_x;         /* centre in the world, in pixels */
+  int16_t         centre_y;
+  uint8_t         up;               /* neighbouring levels, or LAYOUT_NONE */
+  uint8_t         down;
+  uint8_t         left;
+  uint8_t         right;
+} levelinfo_t;
+
+
+/*
+ * layout_count - counts the levels in the grid.
+ */
+
+constexpr uint8_t layout_count( void )
+{
+  uint8_t l_count = 0;
+
+  for ( uint8_t l_row = 0; l_row < LAYOUT_GRID_H; l_row++ )
+  {
+    for ( uint8_t l_column = 0; l_column < LAYOUT_GRID_W; l_column++ )
+    {
+      if ( '#' == g_layout_grid[l_row][l_column] )
+      {
+        l_count++;
+      }
+    }
+  }
+
+  /* All done. */
+  return l_count;
+}
+
+#define LAYOUT_LEVELS       layout_count()
+
+/* The table is indexed by level number, so entry 0 is never used. */
+
+typedef struct
+{
+  levelinfo_t     level[LAYOUT_LEVELS + 1];
+} layout_t;
+
+
+/*
+ * layout_build - builds the level table from the grid. Moving in any
+ *                direction takes you to the nearest level that way, on the
+ *                same row or column, skipping over any gaps.
+ */
+
+constexpr layout_t layout_build( void )
+{
+  layout_t l_layout = {};
+  uint8_t  l_slots[LAYOUT_GRID_H][LAYOUT_GRID_W] = {};
+  uint8_t  l_level = 0;
+
+  /* Number the levels first, and work out where they are. */
+  for ( uint8_t l_row = 0; l_row < LAYOUT_GRID_H; l_row++ )
+  {
+    for ( uint8_t l_column = 0; l_column < LAYOUT_GRID_W; l_column++ )
+    {
+      if ( '#' != g_layout_grid[l_row][l_column] )
+      {
+        continue;
+      }
+      l_slots[l_row][l_column] = ++l_level;
+
+      levelinfo_t &l_info = l_layout.level[l_level];
+      l_info.tile_x = l_column * LAYOUT_LEVEL_W;
+      l_info.tile_y = l_row * LAYOUT_LEVEL_H;
+      l_info.centre_x = ( l_column * LAYOUT_LEVEL_W + LAYOUT_LEVEL_W / 2 ) * LAYOUT_TILE_SIZE;
+      l_info.centre_y = ( l_row * LAYOUT_LEVEL_H + LAYOUT_LEVEL_H / 2 ) * LAYOUT_TILE_SIZE;
+    }
+  }
+
+  /* And then look around each one for its neighbours. */
+  for ( uint8_t l_row = 0; l_row < LAYOUT_GRID_H; l_row++ )
+  {
+    for ( uint8_t l_column = 0; l_column < LAYOUT_GRID_W; l_column++ )
+    {
+      if ( LAYOUT_NONE == l_slots[l_row][l_column] )
+      {
+        continue;
+      }
+      levelinfo_t &l_info = l_layout.level[l_slots[l_row][l_column]];
+
+      for ( int8_t l_look = l_row - 1; ( l_look >= 0 ) && ( LAYOUT_NONE == l_info.up ); l_look-- )
+      {
+        l_info.up = l_slots[l_look][l_column];
+      }
+      for ( int8_t l_look = l_row + 1; ( l_look < LAYOUT_GRID_H ) && ( LAYOUT_NONE == l_info.down ); l_look++ )
+      {
+        l_info.down = l_slots[l_look][l_column];
+      }
+      for ( int8_t l_look = l_column - 1; ( l_look >= 0 ) && ( LAYOUT_NONE == l_info.left ); l_look-- )
+      {
+        l_info.left = l_slots[l_row][l_look];
+      }
+      for ( int8_t l_look = l_column + 1; ( l_look < LAYOUT_GRID_W ) && ( LAYOUT_NONE == l_info.right ); l_look++ )
+      {
+        l_info.right = l_slots[l_row][l_look];
+      }
+    }
+  }
+
+  /* All done. */
+  return l_layout;
+}
+
+constexpr layout_t g_layout = layout_build();
+
+
+/*
+ * level_info - returns the table entry for a level.
+ */
+
+inline const levelinfo_t &level_info( uint8_t p_level )
+{
+  return g_layout.level[p_level > LAYOUT_LEVELS ? LAYOUT_NONE : p_level];
+}
+
+
+/*
+ * level_tile_origin - returns the origin of a level on the map, in tiles.
+ */
+
+inline blit::Point level_tile_origin( uint8_t p_level )
+{
+  return blit::Point( level_info( p_level ).tile_x, level_info( p_level ).tile_y );
+}
+
+
+/*
+ * level_centre - returns the centre of a level, in world co-ordinates.
+ */
+
+inline blit::Point level_centre( uint8_t p_level )
+{
+  return blit::Point( level_info( p_level ).centre_x, level_info( p_level ).centre_y );
+}
+
+#endif /* _LAYOUT_HPP_ */
+
+/* End of file Layout.hpp */
@@ -0,0 +1,339 @@
+/*
+ * LevelPack.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The LevelPack reads external level packs, in the standard XSB text format.
+ * The file is never loaded whole; on Linux hosts it's memory mapped, and on
+ * the device it's read a chunk at a time. Once a pack is open we build an
+ * index of where each level starts, a step at a time so that a big pack
+ * doesn't stall loading, and after that we only ever decode the one level
+ * that is asked for.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstring>
+#include <utility>
+
+#if defined( __linux__ ) && !defined( TARGET_32BLIT_HW )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "LevelPack.hpp"
+
+
+/* Functions. */
+
+/*
+ * LevelPack - constructor; takes over the pack file opened by levelpack_open,
+ *             and the (LEVELPACK_MAX_LEVELS long) block of memory to keep the
+ *             index in. Nothing is indexed yet.
+ */
+
+LevelPack::LevelPack( packfile_t &p_file, uint32_t *p_offsets )
+{
+#ifdef LEVELPACK_MMAP
+  c_file.map = p_file.map;
+  p_file.map = nullptr;
+#else
+  c_file.file = std::move( p_file.file );
+  c_chunk_base = 0;
+  c_chunk_length = 0;
+#endif /* LEVELPACK_MMAP */
+  c_file.size = p_file.size;
+  c_offsets = p_offsets;
+  c_count = 0;
+  c_indexed = 0;
+  c_in_level = false;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * ~LevelPack - destructor, lets go of the file.
+ */
+
+LevelPack::~LevelPack( void )
+{
+  levelpack_close( c_file );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * byte_at - returns the byte at the given offset in the file, or -1 if that's
+ *           past the end. On the device, reads go through a small chunk
+ *           buffer; we nearly always read forwards, so that works nicely.
+ */
+
+int16_t LevelPack::byte_at( uint32_t p_offset )
+{
+  if ( p_offset >= c_file.size )
+  {
+    return -1;
+  }
+
+#ifdef LEVELPACK_MMAP
+  return c_file.map[p_offset];
+#else
+  /* Fetch the chunk this lives in, if we don't have it. */
+  if ( ( p_offset < c_chunk_base ) || ( p_offset >= ( c_chunk_base + c_chunk_length ) ) )
+  {
+    int32_t l_read = c_file.file.read( p_offset, LEVELPACK_CHUNK, (char *)c_chunk );
+    c_chunk_base = p_offset;
+    c_chunk_length = ( l_read > 0 ) ? l_read : 0;
+    if ( 0 == c_chunk_length )
+    {
+      return -1;
+    }
+  }
+  return c_chunk[p_offset - c_chunk_base];
+#endif /* LEVELPACK_MMAP */
+}
+
+
+/*
+ * line_end - returns the offset of the end of the line starting at the offset
+ *            given; that's the newline (or the end of the file).
+ */
+
+uint32_t LevelPack::line_end( uint32_t p_offset )
+{
+  int16_t l_byte;
+
+  while ( ( ( l_byte = byte_at( p_offset ) ) >= 0 ) && ( '\n' != l_byte ) )
+  {
+    p_offset++;
+  }
+
+  return p_offset;
+}
+
+
+/*
+ * map_line - decides if the line between the two offsets is part of a level;
+ *            that means it's made only of level characters, with at least one
+ *            wall in it. Anything else is a title, comment or blank.
+ */
+
+bool LevelPack::map_line( uint32_t p_start, uint32_t p_end )
+{
+  bool l_wall = false;
+
+  for ( uint32_t l_offset = p_start; l_offset < p_end; l_offset++ )
+  {
+    int16_t l_byte = byte_at( l_offset );
+    if ( '#' == l_byte )
+    {
+      l_wall = true;
+    }
+    else if ( ( nullptr == strchr( " @+$*.-_\r", l_byte ) ) || ( 0 == l_byte ) )
+    {
+      return false;
+    }
+  }
+
+  return l_wall;
+}
+
+
+/*
+ * levelpack_open - opens the pack file given, ready to hand to a LevelPack;
+ *                  this is done first so that nothing is allocated for a
+ *                  pack we can't read. Returns false if the file can't be
+ *                  opened, or is empty.
+ */
+
+bool levelpack_open( const char *p_filename, packfile_t &p_file )
+{
+#ifdef LEVELPACK_MMAP
+  /* Map the whole thing in; the kernel only pages in what we touch. */
+  p_file.map = nullptr;
+  p_file.size = 0;
+  int l_fd = ::open( p_filename, O_RDONLY );
+  if ( l_fd < 0 )
+  {
+    return false;
+  }
+  struct stat l_stat;
+  if ( ( fstat( l_fd, &l_stat ) < 0 ) || ( 0 == l_stat.st_size ) )
+  {
+    ::close( l_fd );
+    return false;
+  }
+  void *l_map = mmap( nullptr, l_stat.st_size, PROT_READ, MAP_PRIVATE, l_fd, 0 );
+  ::close( l_fd );
+  if ( MAP_FAILED == l_map )
+  {
+    return false;
+  }
+  p_file.map = (const uint8_t *)l_map;
+  p_file.size = l_stat.st_size;
+#else
+  /* On the device, we just keep the file open and read as we need to. */
+  p_file.size = 0;
+  if ( !blit::file_exists( p_filename ) || !p_file.file.open( p_filename ) )
+  {
+    return false;
+  }
+  p_file.size = p_file.file.get_length();
+  if ( 0 == p_file.size )
+  {
+    p_file.file.close();
+    return false;
+  }
+#endif /* LEVELPACK_MMAP */
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * levelpack_close - lets go of a pack file opened by levelpack_open.
+ */
+
+void levelpack_close( packfile_t &p_file )
+{
+#ifdef LEVELPACK_MMAP
+  if ( nullptr != p_file.map )
+  {
+    munmap( (void *)p_file.map, p_file.size );
+    p_file.map = nullptr;
+  }
+#else
+  p_file.file.close();
+#endif /* LEVELPACK_MMAP */
+  p_file.size = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * index - indexes where the next few levels start, working through at most
+ *         LEVELPACK_INDEX_STEP bytes of the file; call it until it returns
+ *         true, when the whole file has been indexed.
+ */
+
+bool LevelPack::index( void )
+{
+  /* Work through the file a line at a time; a level starts on any map */
+  /* line that doesn't follow another one.                             */
+  uint32_t l_stop = c_indexed + LEVELPACK_INDEX_STEP;
+  while ( ( c_indexed < c_file.size ) && ( c_indexed < l_stop ) )
+  {
+    uint32_t l_end = line_end( c_indexed );
+    bool     l_map = map_line( c_indexed, l_end );
+
+    if ( l_map && !c_in_level )
+    {
+      /* Only so many fit in the index; say so, rather than just stopping. */
+      if ( c_count >= LEVELPACK_MAX_LEVELS )
+      {
+        blit::debugf( "Level pack has more than %u levels, only using the first %u\n",
+                      (unsigned)LEVELPACK_MAX_LEVELS, (unsigned)LEVELPACK_MAX_LEVELS );
+        c_indexed = c_file.size;
+        break;
+      }
+      c_offsets[c_count++] = c_indexed;
+    }
+    c_in_level = l_map;
+    c_indexed = l_end + 1;
+  }
+
+  /* All done, let the caller know if there's any more to do. */
+  return c_indexed >= c_file.size;
+}
+
+
+/*
+ * count - returns the number of levels in the pack.
+ */
+
+uint16_t LevelPack::count( void )
+{
+  /* Simple access method. */
+  return c_count;
+}
+
+
+/*
+ * decode - reads the requested level (counting from zero) into the level
+ *          structure given. Returns false if there's no such level, or if it
+ *          is too big for us to show.
+ */
+
+bool LevelPack::decode( uint16_t p_level, packlevel_t &p_packlevel )
+{
+  /* Make sure it's a level we know about. */
+  if ( p_level >= c_count )
+  {
+    return false;
+  }
+
+  /* Start with an empty level. */
+  memset( p_packlevel.cells, ' ', sizeof( p_packlevel.cells ) );
+  p_packlevel.width = 0;
+  p_packlevel.height = 0;
+
+  /* And read in lines until we hit something that isn't level. */
+  uint32_t l_offset = c_offsets[p_level];
+  while ( l_offset < c_file.size )
+  {
+    uint32_t l_end = line_end( l_offset );
+    if ( !map_line( l_offset, l_end ) )
+    {
+      break;
+    }
+    if ( p_packlevel.height >= LEVELPACK_MAX_H )
+    {
+      return false;
+    }
+
+    /* Copy the line in, tidying up the alternative floor characters. */
+    uint8_t l_width = 0;
+    for ( uint32_t l_byte = l_offset; l_byte < l_end; l_byte++ )
+    {
+      char l_cell = byte_at( l_byte );
+      if ( '\r' == l_cell )
+      {
+        continue;
+      }
+      if ( l_width >= LEVELPACK_MAX_W )
+      {
+        return false;
+      }
+      p_packlevel.cells[p_packlevel.height][l_width++] = ( ( '-' == l_cell ) || ( '_' == l_cell ) ) ? ' ' : l_cell;
+    }
+    if ( l_width > p_packlevel.width )
+    {
+      p_packlevel.width = l_width;
+    }
+    p_packlevel.height++;
+    l_offset = l_end + 1;
+  }
+
+  /* All done. */
+  return true;
+}
+
+
+/* End of file LevelPack.cpp */
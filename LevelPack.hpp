@@ -0,0 +1,83 @@
+/*
+ * LevelPack.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The LevelPack reads external level packs, in the standard XSB text format.
+ * The file is never loaded whole; on Linux hosts it's memory mapped, and on
+ * the device it's read a chunk at a time. Opening a pack builds an index of
+ * where each level starts, and after that we only ever decode the one level
+ * that is asked for.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _LEVELPACK_HPP_
+#define   _LEVELPACK_HPP_
+
+#include "32blit.hpp"
+
+#define LEVELPACK_FILE        "sokoblit.xsb"
+#define LEVELPACK_MAX_LEVELS  2048
+#define LEVELPACK_MAX_W       20      /* the most cells the game can show */
+#define LEVELPACK_MAX_H       15
+#define LEVELPACK_CHUNK       512
+#define LEVELPACK_INDEX_STEP  16384   /* bytes indexed per load() step */
+
+#if defined( __linux__ ) && !defined( TARGET_32BLIT_HW )
+#define LEVELPACK_MMAP
+#endif
+
+/* A single decoded level, as XSB characters; ' ' is floor (or outside). */
+
+typedef struct
+{
+  uint8_t         width;
+  uint8_t         height;
+  char            cells[LEVELPACK_MAX_H][LEVELPACK_MAX_W];
+} packlevel_t;
+
+/* An opened pack file, before there's a LevelPack to hand it to. */
+
+typedef struct
+{
+#ifdef LEVELPACK_MMAP
+  const uint8_t  *map;
+#else
+  blit::File      file;
+#endif /* LEVELPACK_MMAP */
+  uint32_t        size;
+} packfile_t;
+
+class LevelPack
+{
+  private:
+    packfile_t      c_file;
+#ifndef LEVELPACK_MMAP
+    uint8_t         c_chunk[LEVELPACK_CHUNK];
+    uint32_t        c_chunk_base;
+    uint32_t        c_chunk_length;
+#endif /* LEVELPACK_MMAP */
+    uint32_t       *c_offsets;
+    uint16_t        c_count;
+    uint32_t        c_indexed;
+    bool            c_in_level;
+
+    int16_t         byte_at( uint32_t );
+    uint32_t        line_end( uint32_t );
+    bool            map_line( uint32_t, uint32_t );
+
+  public:
+                    LevelPack( packfile_t &, uint32_t * );
+                   ~LevelPack( void );
+    bool            index( void );
+    uint16_t        count( void );
+    bool            decode( uint16_t, packlevel_t & );
+};
+
+bool        levelpack_open( const char *, packfile_t & );
+void        levelpack_close( packfile_t & );
+
+#endif /* _LEVELPACK_HPP_ */
+
+/* End of file LevelPack.hpp */
@@ -11,6 +11,7 @@
 
 /* System headers. */
 
+#include <cstdio>
 #include <cstring>
 
 /* Local headers. */
@@ -18,7 +19,15 @@
 #include "32blit.hpp"
 #include "sokoblit.hpp"
 
+#include "Arena.hpp"
+#include "AssetPack.hpp"
+#include "Delta.hpp"
+#include "Geometry.hpp"
+#include "Governor.hpp"
 #include "Menu.hpp"
+#include "RenderPool.hpp"
+#include "Trace.hpp"
+#include "Tween.hpp"
 #include "assets.hpp"
 #include "assets_tiled.hpp"
 
@@ -31,43 +40,120 @@
 
 Menu::Menu( void )
 {
-  /* Load up the spritesheets and images we'll be using. */
-  c_menu_sprites = blit::Surface::load( at_menu_sprites );
-  c_menu_splash = blit::Surface::load( a_menu_splash );
+  uint32_t l_start = blit::now_us();
+  void    *l_block;
+
+  /* Load up the spritesheets and images we'll be using; anything we can't */
+  /* find room for is just left out, rather than going to the heap.        */
+  c_menu_splash = nullptr;
+  c_splash_sheet = nullptr;
+  l_block = g_arena.alloc( ARENA_MENU_SPLASH, ARENA_SPRITES );
+  if ( nullptr != l_block )
+  {
+    c_menu_splash = ASSET_SURFACE( a_menu_splash, (uint8_t *)l_block, ARENA_MENU_SPLASH );
+  }
+  l_block = g_arena.alloc( sizeof( SpriteSheet ), ARENA_SPRITES );
+  if ( ( nullptr == c_menu_splash ) || ( nullptr == l_block ) )
+  {
+    blit::debugf( "Menu load failed: out of arena for the menu splash\n" );
+  }
+  else
+  {
+    if ( ARENA_SPLASH_FORMAT != c_menu_splash->format )
+    {
+      blit::debugf( "Menu splash is not in the format its arena space was sized for\n" );
+    }
+    c_splash_sheet = new( l_block ) SpriteSheet( c_menu_splash );
+  }
+  log_phase( "menu splash", l_start );
+
+  l_start = blit::now_us();
+  c_menu_sprites = nullptr;
+  l_block = g_arena.alloc( ARENA_MENU_SPRITES, ARENA_SPRITES );
+  if ( nullptr != l_block )
+  {
+    c_menu_sprites = ASSET_SURFACE( at_menu_sprites, (uint8_t *)l_block, ARENA_MENU_SPRITES );
+  }
+  if ( nullptr == c_menu_sprites )
+  {
+    blit::debugf( "Menu load failed: out of arena for the menu sprites\n" );
+  }
+  else if ( ARENA_MENU_FORMAT != c_menu_sprites->format )
+  {
+    blit::debugf( "Menu sprites are not in the format their arena space was sized for\n" );
+  }
+  log_phase( "menu sprites", l_start );
 
   /* And the tile map, too - copied into a malleable chunk of memory. */
-  c_menu_tiles = new uint8_t[at_menu_map_length];
-  if ( nullptr != c_menu_tiles )
+  l_start = blit::now_us();
+  c_menu_map = nullptr;
+  c_menu_tiles = (uint8_t *)g_arena.alloc( at_menu_map_length, ARENA_TILEMAPS );
+  l_block = g_arena.alloc( sizeof( blit::TileMap ), ARENA_TILEMAPS );
+  if ( ( nullptr == c_menu_tiles ) || ( nullptr == l_block ) || ( nullptr == c_menu_sprites ) )
   {
-    memcpy( c_menu_tiles, at_menu_map, at_menu_map_length );
-    c_menu_map = new blit::TileMap( c_menu_tiles, nullptr, blit::Size( 256, 256 ), c_menu_sprites );
+    blit::debugf( "Menu load failed: out of arena for the menu map\n" );
   }
+  else
+  {
+    /* The menu layout is fixed too, so a packed map must match in size. */
+    uint32_t       l_length;
+    const uint8_t *l_tiles = g_assets.find( "at_menu_map", at_menu_map, at_menu_map_length, &l_length );
+    if ( at_menu_map_length != l_length )
+    {
+      blit::debugf( "Asset pack menu map is the wrong size, using the built in one\n" );
+      l_tiles = at_menu_map;
+    }
+    memcpy( c_menu_tiles, l_tiles, at_menu_map_length );
+    c_menu_map = new( l_block )
+                   blit::TileMap( c_menu_tiles, nullptr, blit::Size( 256, 256 ), c_menu_sprites );
+  }
+  log_phase( "menu map", l_start );
 
   /* And a few other defaults. */
   c_zoom = 100;
   c_movetimer = 0;
 
+  /* There's no level pack to browse until the game has found one. */
+  c_pack = nullptr;
+  c_thumbs = nullptr;
+  c_browsing = false;
+  c_pack_level = 0;
+  c_pack_first = 0;
+
+  /* Nor any level windows, until the game is ready to fill them. */
+  c_game = nullptr;
+  memset( c_windows, 0, sizeof( c_windows ) );
+
+  /* Build the tilemap callback here, rather than on every frame. */
+  c_map_scanline = [this]( uint8_t p_scanline ) { return map_transform( p_scanline ); };
+
   /* All done! */
   return;
 }
 
 
 /*
- * ~Menu - destructor, just tidy up what we allocated.
+ * ~Menu - destructor, just tidy up what we allocated. Anything carved out of
+ *         the arena is simply destructed; the memory itself is never freed.
  */
 
 Menu::~Menu( void )
 {
-  /* Free the tilemap. */
+  /* Free the tilemaps. */
   if ( nullptr != c_menu_map )
   {
-    delete c_menu_map;
+    c_menu_map->~TileMap();
     c_menu_map = nullptr;
   }
-  if ( nullptr != c_menu_tiles )
+  c_menu_tiles = nullptr;
+  for ( uint8_t l_window = 0; l_window <= MENU_WINDOWS; l_window++ )
   {
-    delete c_menu_tiles;
-    c_menu_tiles = nullptr;
+    if ( nullptr != c_windows[l_window].map )
+    {
+      c_windows[l_window].map->~TileMap();
+      c_windows[l_window].map = nullptr;
+    }
+    c_windows[l_window].tiles = nullptr;
   }
 
   /* And the sprites. */
@@ -76,6 +162,23 @@ Menu::~Menu( void )
     delete c_menu_sprites;
     c_menu_sprites = nullptr;
   }
+  if ( nullptr != c_splash_sheet )
+  {
+    c_splash_sheet->~SpriteSheet();
+    c_splash_sheet = nullptr;
+  }
+
+  /* And any thumbnails. */
+  if ( nullptr != c_thumbs )
+  {
+    c_thumbs->~ThumbCache();
+    c_thumbs = nullptr;
+  }
+  if ( nullptr != c_menu_splash )
+  {
+    delete c_menu_splash;
+    c_menu_splash = nullptr;
+  }
 
   /* All done. */
   return;
@@ -91,20 +194,19 @@ blit::Rect Menu::level_rect( uint8_t p_level )
 {
   blit::Rect l_rect = blit::Rect( 0, 0, 0, 0 );
 
-  /* Work out the zoomed size of it. */
-  l_rect.w = blit::screen.bounds.w / ( 1.0f + c_zoom / 25.0f ) - 2;
-  l_rect.h = blit::screen.bounds.h / ( 1.0f + c_zoom / 25.0f ) - 2;
+  /* Work out the zoomed size of it; the scale includes any lores drop. */
+  fixed_t l_inverse = zoom_inverse( c_zoom ) / render_scale();
+  l_rect.w = FIXED_FLOOR( SOKOBLIT_WORLD_W * l_inverse ) - 2;
+  l_rect.h = FIXED_FLOOR( SOKOBLIT_WORLD_H * l_inverse ) - 2;
 
   /* And then work out the location, too - start with the map location. */
   blit::Point l_levelloc = level_centre( p_level );
-  blit::Vec2 l_centre = blit::Vec2( l_levelloc.x, l_levelloc.y ); 
-  l_centre.x -= blit::screen.bounds.w / 2;
-  l_centre.y -= blit::screen.bounds.h / 2;
-  l_centre -= l_centre * ( 1.0f - c_zoom / 100.0f );
+  fixed_t l_centre_x = ( l_levelloc.x - SOKOBLIT_WORLD_W / 2 ) * zoom_fraction( c_zoom );
+  fixed_t l_centre_y = ( l_levelloc.y - SOKOBLIT_WORLD_H / 2 ) * zoom_fraction( c_zoom );
 
   /* Apply the zoom transform. */
-  l_rect.x = l_centre.x / ( 1.0f + c_zoom / 25.0f ) + 1;
-  l_rect.y = l_centre.y / ( 1.0f + c_zoom / 25.0f ) + 1;
+  l_rect.x = FIXED_FLOOR( fixed_mul( l_centre_x, l_inverse ) ) + 1;
+  l_rect.y = FIXED_FLOOR( fixed_mul( l_centre_y, l_inverse ) ) + 1;
 
   /* All done. */
   return l_rect;
@@ -113,28 +215,13 @@ blit::Rect Menu::level_rect( uint8_t p_level )
 
 /*
  * map_transform - callback for the tilemap render, where we apply a suitable
- *                 level of zoom.
+ *                 level of zoom. The transform is the same for every scanline
+ *                 so it's worked out once a frame, in render().
  */
 
 blit::Mat3 Menu::map_transform( uint8_t p_scanline )
 {
-  blit::Mat3  l_transform = blit::Mat3::identity();
-  blit::Point l_levelloc = level_centre( g_level );
-
-  /* Centre things, scaled on zoom. */
-  blit::Vec2 l_centre = blit::Vec2( l_levelloc.x, l_levelloc.y );
-  l_centre += ( blit::Vec2( 800, 600 ) - l_centre ) * c_zoom / 100.0f;
-  l_transform *= blit::Mat3::translation( l_centre );
-
-  /* Then work out the scale vector, based on the current zoom percentage. */
-  float l_scale = 1.0f + ( c_zoom / 25.0f );
-  l_transform *= blit::Mat3::scale( blit::Vec2( l_scale, l_scale ) );
-
-  /* Lastly, transform to the centre of the screen. */
-  l_transform *= blit::Mat3::translation( blit::Vec2( blit::screen.bounds.w / 2 * -1, blit::screen.bounds.h / 2 * -1 ) );
-
-  /* Return the transform we've ended up with. */
-  return l_transform;
+  return c_map_matrix;
 }
 
 
@@ -144,88 +231,447 @@ blit::Mat3 Menu::map_transform( uint8_t p_scanline )
 
 void Menu::update( uint32_t p_time )
 {
+  uint8_t l_level = g_level;
+
   /* We only respond to user input when we're fully zoomed. */
   if ( c_zoom < 100 )
   {
+    g_tweener.cancel( &c_movetimer );
     c_movetimer = 0;
     return;
   }
 
-  /* Put in a repeat delay on movements. */
+  /* If there's a level pack, X flips between browsing it and the map. */
+  if ( ( nullptr != c_thumbs ) && ( blit::buttons.pressed & blit::Button::X ) )
+  {
+    c_browsing = !c_browsing;
+  }
+
+  /* Put in a repeat delay on movements; the tweener runs it down. */
   if ( c_movetimer > 0 )
   {
-    c_movetimer--;
     return;
   }
 
-  /* So, the only inputs are left/right/up/down around the levels. */
-  if ( ( blit::pressed( blit::Button::DPAD_LEFT ) ) || ( blit::joystick.x < -0.3f ) )
+  /* The pack browser has its own idea of moving around. */
+  if ( c_browsing )
+  {
+    update_browser();
+    return;
+  }
+
+  /* So, the only inputs are left/right/up/down around the levels; the */
+  /* layout knows which level lies in each direction, if any.          */
+  if ( ( ( blit::pressed( blit::Button::DPAD_LEFT ) ) || ( blit::joystick.x < -0.3f ) ) &&
+       ( LAYOUT_NONE != level_info( g_level ).left ) )
+  {
+    g_level = level_info( g_level ).left;
+  }
+  if ( ( ( blit::pressed( blit::Button::DPAD_RIGHT ) ) || ( blit::joystick.x > 0.3f ) ) &&
+       ( LAYOUT_NONE != level_info( g_level ).right ) )
+  {
+    g_level = level_info( g_level ).right;
+  }
+  if ( ( ( blit::pressed( blit::Button::DPAD_UP ) ) || ( blit::joystick.y < -0.3f ) ) &&
+       ( LAYOUT_NONE != level_info( g_level ).up ) )
+  {
+    g_level = level_info( g_level ).up;
+  }
+  if ( ( ( blit::pressed( blit::Button::DPAD_DOWN ) ) || ( blit::joystick.y > 0.3f ) ) &&
+       ( LAYOUT_NONE != level_info( g_level ).down ) )
+  {
+    g_level = level_info( g_level ).down;
+  }
+
+  /* If we moved, hold off the next move for a little while. */
+  if ( l_level != g_level )
+  {
+    c_movetimer = 1;
+    g_tweener.start( &c_movetimer, 0, MENU_REPEAT_MS, EASE_LINEAR );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * update_browser - moves the selection around the pack browser; left and right
+ *                  step a level at a time, up and down a row, and we page
+ *                  through the pack as the selection runs off either end.
+ */
+
+void Menu::update_browser( void )
+{
+  uint16_t l_level = c_pack_level;
+  uint16_t l_count = c_pack->count();
+
+  if ( ( ( blit::pressed( blit::Button::DPAD_LEFT ) ) || ( blit::joystick.x < -0.3f ) ) &&
+       ( c_pack_level > 0 ) )
+  {
+    c_pack_level--;
+  }
+  if ( ( ( blit::pressed( blit::Button::DPAD_RIGHT ) ) || ( blit::joystick.x > 0.3f ) ) &&
+       ( c_pack_level + 1 < l_count ) )
+  {
+    c_pack_level++;
+  }
+  if ( ( ( blit::pressed( blit::Button::DPAD_UP ) ) || ( blit::joystick.y < -0.3f ) ) &&
+       ( c_pack_level >= MENU_BROWSE_COLS ) )
+  {
+    c_pack_level -= MENU_BROWSE_COLS;
+  }
+  if ( ( ( blit::pressed( blit::Button::DPAD_DOWN ) ) || ( blit::joystick.y > 0.3f ) ) &&
+       ( c_pack_level + MENU_BROWSE_COLS < l_count ) )
+  {
+    c_pack_level += MENU_BROWSE_COLS;
+  }
+
+  /* Keep the page in step with the selection. */
+  c_pack_first = ( c_pack_level / MENU_BROWSE_PAGE ) * MENU_BROWSE_PAGE;
+
+  /* If we moved, hold off the next move for a little while. */
+  if ( l_level != c_pack_level )
+  {
+    c_movetimer = 1;
+    g_tweener.start( &c_movetimer, 0, MENU_REPEAT_MS, EASE_LINEAR );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * set_pack - tells us about the game's level pack, if it has one; this is
+ *            when we set aside room for the thumbnails we'll browse it with.
+ */
+
+void Menu::set_pack( LevelPack *p_pack )
+{
+  /* Only needs doing the once, and only if there's anything to browse. */
+  if ( ( nullptr != c_thumbs ) || ( nullptr == p_pack ) || ( 0 == p_pack->count() ) )
+  {
+    return;
+  }
+
+  /* Without room for the thumbnails, there's simply no browsing. */
+  void *l_block = g_arena.alloc( sizeof( ThumbCache ), ARENA_SPRITES );
+  if ( nullptr == l_block )
   {
-    /* Left is mostly simple, long as you're not at the edge already. */
-    if ( ( 1 != g_level ) && ( 6 != g_level ) && ( 11 != g_level ) &&
-         ( 13 != g_level ) && ( 18 != g_level ) )
+    blit::debugf( "Menu load failed: out of arena for the pack thumbnails\n" );
+    return;
+  }
+  c_pack = p_pack;
+  c_thumbs = new( l_block ) ThumbCache( p_pack );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * set_game - tells us about the game, once it's loaded; this is when we set
+ *            aside room for the windows that changed levels are drawn from.
+ *            Without them, the overview just shows every level as it began.
+ */
+
+void Menu::set_game( Game *p_game )
+{
+  /* Only needs doing the once, and only once there's a game to draw. */
+  if ( ( nullptr != c_game ) || ( nullptr == p_game ) || ( !p_game->ready() ) )
+  {
+    return;
+  }
+
+  for ( uint8_t l_window = 0; l_window <= MENU_WINDOWS; l_window++ )
+  {
+    c_windows[l_window].tiles = (uint8_t *)g_arena.alloc( GAME_WINDOW_W * GAME_WINDOW_H, ARENA_TILEMAPS );
+    void *l_block = g_arena.alloc( sizeof( blit::TileMap ), ARENA_TILEMAPS );
+    if ( ( nullptr == c_windows[l_window].tiles ) || ( nullptr == l_block ) )
     {
-      g_level--;
-      c_movetimer = 20;
+      blit::debugf( "Menu load failed: out of arena for the level windows\n" );
+      return;
     }
+    memset( c_windows[l_window].tiles, 0, GAME_WINDOW_W * GAME_WINDOW_H );
+    c_windows[l_window].map = new( l_block )
+      blit::TileMap( c_windows[l_window].tiles, nullptr, blit::Size( GAME_WINDOW_W, GAME_WINDOW_H ), p_game->sprites() );
   }
+  c_game = p_game;
 
-  if ( ( blit::pressed( blit::Button::DPAD_RIGHT ) ) || ( blit::joystick.x > 0.3f ) )
+  /* All done. */
+  return;
+}
+
+
+/*
+ * find_window - returns the window holding the given level, if there is one.
+ */
+
+levelwindow_t *Menu::find_window( uint8_t p_level )
+{
+  for ( uint8_t l_window = 0; l_window <= MENU_WINDOWS; l_window++ )
   {
-    /* Same as right. */
-    if ( ( 5 != g_level ) && ( 10 != g_level ) && ( 12 != g_level ) &&
-         ( 17 != g_level ) && ( 22 != g_level ) )
+    if ( c_windows[l_window].level == p_level )
     {
-      g_level++;
-      c_movetimer = 20;
+      return &c_windows[l_window];
     }
   }
 
-  /* Up is ... a little messier. */
-  if ( ( blit::pressed( blit::Button::DPAD_UP ) ) || ( blit::joystick.y < -0.3f ) )
+  /* All done, not found. */
+  return nullptr;
+}
+
+
+/*
+ * claim_window - finds a window for a level that doesn't have one; one that
+ *                is free, or whose level is back as it started, or failing
+ *                that the shared one. It's filled from the game, which is
+ *                the only time a level is copied over whole.
+ */
+
+levelwindow_t *Menu::claim_window( uint8_t p_level )
+{
+  levelwindow_t *l_window = &c_windows[MENU_WINDOWS];
+
+  for ( uint8_t l_index = 0; l_index < MENU_WINDOWS; l_index++ )
   {
-    /* Simple options first. */
-    if ( ( 6 <= g_level ) && 
-         ( ( 11 >= g_level ) || ( 17 <= g_level ) ) )
+    if ( ( 0 == c_windows[l_index].level ) || ( !c_game->windowed( c_windows[l_index].level ) ) )
     {
-      g_level -= 5;
-      c_movetimer = 20;
+      l_window = &c_windows[l_index];
+      break;
     }
+  }
+
+  /* Catch it up with the level, as it is now. */
+  l_window->level = p_level;
+  c_game->fill_window( l_window->tiles, p_level );
+
+  /* All done. */
+  return l_window;
+}
+
 
-    /* And five edge cases. */
-    else if ( ( 12 == g_level ) || ( 13 == g_level ) )
+/*
+ * sync - applies any changes the game has made to its map since we last
+ *        looked, so that the overview shows how far the player has got. A
+ *        moved crate is just its tiles copied into the level's window; a
+ *        level that lost changes is filled again, but only the once.
+ */
+
+void Menu::sync( void )
+{
+  tiledelta_t    l_delta;
+  levelwindow_t *l_window;
+
+  while ( g_deltas.pop( l_delta ) )
+  {
+    /* Without windows, there's nowhere to put the changes. */
+    if ( nullptr == c_game )
     {
-      g_level -= 2;
-      c_movetimer = 20;
+      continue;
     }
-    else if ( ( 14 <= g_level ) && ( 16 >= g_level ) )
+    l_window = find_window( l_delta.level );
+
+    switch( l_delta.kind )
     {
-      g_level -= 7;
-      c_movetimer = 20;
+      case DELTA_LEVEL_RESET:
+        /* The level is as it started, so it can come from flash again. */
+        if ( nullptr != l_window )
+        {
+          l_window->level = 0;
+        }
+        break;
+
+      case DELTA_LEVEL_DIRTY:
+        /* We've missed something; if we're holding it, catch up. */
+        if ( nullptr != l_window )
+        {
+          c_game->fill_window( l_window->tiles, l_delta.level );
+        }
+        break;
+
+      case DELTA_TILE:
+        /* A level we're not holding is filled whole, which takes in this */
+        /* change too; otherwise it's just the one cell.                  */
+        if ( nullptr == l_window )
+        {
+          if ( c_game->windowed( l_delta.level ) )
+          {
+            claim_window( l_delta.level );
+          }
+          break;
+        }
+        for ( uint8_t l_corner = 0; l_corner < METATILE_TILES; l_corner++ )
+        {
+          blit::Point l_tile = blit::Point( l_delta.x, l_delta.y ) - level_tile_origin( l_delta.level ) +
+                               blit::Point( 1 + ( l_corner % RULES_CELL ), 1 + ( l_corner / RULES_CELL ) );
+          l_window->tiles[l_tile.x + ( l_tile.y * GAME_WINDOW_W )] = l_delta.tiles[l_corner];
+        }
+        break;
     }
   }
 
-  /* As is down. */
-  if ( ( blit::pressed( blit::Button::DPAD_DOWN ) ) || ( blit::joystick.y > 0.3f ) )
+  /* All done. */
+  return;
+}
+
+
+/*
+ * level_map - returns the tilemap to draw a level from in the overview, or
+ *             nullptr if it's just as it is in flash. Only a level that has
+ *             lost its window to another is filled again here.
+ */
+
+blit::TileMap *Menu::level_map( uint8_t p_level )
+{
+  /* Levels as they started don't need a window at all. */
+  if ( ( nullptr == c_game ) || ( !c_game->windowed( p_level ) ) )
   {
-    /* Simple options first. */
-    if ( ( 17 >= g_level ) && 
-         ( ( 6 >= g_level ) || ( 12 <= g_level ) ) )
+    return nullptr;
+  }
+
+  levelwindow_t *l_window = find_window( p_level );
+  if ( nullptr == l_window )
+  {
+    l_window = claim_window( p_level );
+  }
+
+  /* All done. */
+  return l_window->map;
+}
+
+
+/*
+ * browsing - returns true if we're showing the pack browser, rather than
+ *            the level map.
+ */
+
+bool Menu::browsing( void )
+{
+  /* Simple access method. */
+  return c_browsing;
+}
+
+
+/*
+ * signature - sums up the state of the pack browser, so that the caller can
+ *             tell when it needs redrawing; that includes new thumbnails
+ *             arriving while the page fills in.
+ */
+
+uint32_t Menu::signature( void )
+{
+  if ( !c_browsing )
+  {
+    return 0;
+  }
+  return ( c_thumbs->generated() << 16 ) ^ ( c_pack_level + 1 );
+}
+
+
+/*
+ * pulsing - if the only thing changing on the menu is the pulsing rectangle,
+ *           returns true and fills in the area it covers, which is all that
+ *           needs to be redrawn. If it's not pulsing, or pulsing under the
+ *           splash, we can't help.
+ */
+
+bool Menu::pulsing( blit::Rect *p_bounds )
+{
+  blit::Rect l_edges[4];
+
+  /* The rectangle only pulses when it's fully visible, and allowed to. */
+  if ( c_browsing || ( c_zoom < 100 ) || ( g_governor.tier() >= QUALITY_STILL_PULSE ) )
+  {
+    return false;
+  }
+
+  /* So, work out where the edges are; the bottom one reaches the corner. */
+  blit::Rect l_level = level_rect( g_level );
+  l_edges[0] = blit::Rect( l_level.tl(), blit::Size( l_level.w, 1 ) );
+  l_edges[1] = blit::Rect( l_level.bl(), blit::Size( l_level.w + 1, 1 ) );
+  l_edges[2] = blit::Rect( l_level.tl(), blit::Size( 1, l_level.h ) );
+  l_edges[3] = blit::Rect( l_level.tr(), blit::Size( 1, l_level.h ) );
+  *p_bounds = blit::Rect( l_level.tl(), blit::Size( l_level.w + 1, l_level.h + 1 ) );
+
+  /* And make sure none of them runs under the splash. */
+  if ( nullptr == c_menu_splash )
+  {
+    return true;
+  }
+  blit::Rect l_splash = blit::Rect(
+    ( blit::screen.bounds.w - c_menu_splash->bounds.w ) / 2,
+    ( blit::screen.bounds.h - c_menu_splash->bounds.h ) / 2,
+    c_menu_splash->bounds.w, c_menu_splash->bounds.h
+  );
+  for ( uint8_t l_edge = 0; l_edge < 4; l_edge++ )
+  {
+    if ( l_edges[l_edge].intersects( l_splash ) )
+    {
+      return false;
+    }
+  }
+
+  /* All good. */
+  return true;
+}
+
+
+/*
+ * render_browser - draws a page of pack levels as a grid of thumbnails, with
+ *                  the selected one outlined. Thumbnails we don't have yet
+ *                  are left as a plain box; they'll arrive in a frame or two.
+ */
+
+void Menu::render_browser( void )
+{
+  char l_buffer[8];
+
+  /* A new frame means a new allowance of thumbnails to draw. */
+  c_thumbs->frame();
+
+  /* Each level gets a box, with the thumbnail keeping its shape in it. */
+  blit::Size l_box = blit::Size( blit::screen.bounds.w / MENU_BROWSE_COLS,
+                                 blit::screen.bounds.h / MENU_BROWSE_ROWS );
+  blit::Size l_size = blit::Size( l_box.w - 8, ( l_box.w - 8 ) * THUMB_H / THUMB_W );
+
+  for ( uint8_t l_index = 0; l_index < MENU_BROWSE_PAGE; l_index++ )
+  {
+    uint16_t l_level = c_pack_first + l_index;
+    if ( l_level >= c_pack->count() )
     {
-      g_level += 5;
-      c_movetimer = 20;
+      break;
     }
 
-    /* And five edge cases. */
-    else if ( ( 10 == g_level ) || ( 11 == g_level ) )
+    blit::Rect l_thumb = blit::Rect( blit::Point( ( l_index % MENU_BROWSE_COLS ) * l_box.w + 4,
+                                                  ( l_index / MENU_BROWSE_COLS ) * l_box.h + 4 ),
+                                     l_size );
+    blit::Surface *l_surface = c_thumbs->get( l_level );
+    if ( nullptr != l_surface )
     {
-      g_level += 2;
-      c_movetimer = 20;
+      blit::screen.stretch_blit( l_surface, blit::Rect( 0, 0, THUMB_W, THUMB_H ), l_thumb );
     }
-    else if ( ( 7 <= g_level ) && ( 9 >= g_level ) )
+    else
     {
-      g_level += 7;
-      c_movetimer = 20;
+      blit::screen.pen = blit::Pen( 40, 40, 50 );
+      blit::screen.rectangle( l_thumb );
+    }
+
+    /* Label it with the level number, counting from one like the map. */
+    snprintf( l_buffer, sizeof( l_buffer ), "%u", (unsigned)( l_level + 1 ) );
+    blit::screen.pen = blit::Pen( 255, 255, 255 );
+    blit::screen.text( l_buffer, blit::minimal_font, blit::Point( l_thumb.x, l_thumb.y + l_thumb.h + 2 ) );
+
+    /* And outline the selected one. */
+    if ( l_level == c_pack_level )
+    {
+      l_thumb.inflate( 2 );
+      blit::screen.pen = blit::Pen( 250, 128, 200 );
+      blit::screen.h_span( l_thumb.tl(), l_thumb.w );
+      blit::screen.h_span( l_thumb.bl(), l_thumb.w + 1 );
+      blit::screen.v_span( l_thumb.tl(), l_thumb.h );
+      blit::screen.v_span( l_thumb.tr(), l_thumb.h );
     }
   }
 
@@ -244,31 +690,74 @@ void Menu::render( uint32_t p_time, uint8_t p_zoom )
   /* Save the zoom factor, making sure it's a sensible value. */
   c_zoom = ( p_zoom > 100 ) ? 100 : p_zoom;
 
-  /* Set the alpha for all of this depending on the zoom. */
+  /* The pack browser replaces the map entirely. */
+  if ( c_browsing )
+  {
+    render_browser();
+    return;
+  }
+
+  /* Work out the transform for the map, once for the frame. */
+  c_map_matrix = map_matrix( map_view( g_level, c_zoom ), blit::Point( 0, 0 ) );
+
+  /* Set the alpha for all of this depending on the zoom; if we're short  */
+  /* of time, the governor may decide we can't afford to fade things.    */
   uint8_t l_previous_alpha = blit::screen.alpha;
-  blit::screen.alpha = c_zoom < 20 ? 0 : ( c_zoom - 20 ) * 3.18;
+  uint8_t l_alpha = c_zoom < 20 ? 0 : ( c_zoom - 20 ) * 3.18;
+  blit::screen.alpha = g_governor.fade( l_alpha, QUALITY_NO_FADES );
 
   /* Ask the tilemap to draw itself, as a suitble zoom & alpha. */
-  if ( nullptr != c_menu_map )
+  if ( ( nullptr != c_menu_map ) && ( 0 < blit::screen.alpha ) )
   {
-    c_menu_map->draw( &blit::screen, blit::screen.clip, std::bind( &Menu::map_transform, this, std::placeholders::_1 ) );
+    TRACE_BEGIN( "TileMap::draw" );
+    g_renderpool.draw( c_menu_map, &blit::screen, blit::screen.clip, c_map_scanline );
+    TRACE_END( "TileMap::draw" );
   }
 
-  /* Draw a pulsing rectangle around the current level. */
+  /* Draw a pulsing rectangle around the current level; or just a plain */
+  /* one, if the governor has told us to stop pulsing.                  */
   blit::Rect l_level = level_rect( g_level );
-  blit::screen.pen = blit::Pen( 250, ( p_time % 255 ), 150 + ( p_time % 105 ) );
+  if ( g_governor.tier() >= QUALITY_STILL_PULSE )
+  {
+    blit::screen.pen = blit::Pen( 250, 128, 200 );
+  }
+  else
+  {
+    blit::screen.pen = blit::Pen( 250, ( p_time % 255 ), 150 + ( p_time % 105 ) );
+  }
   blit::screen.h_span( l_level.tl(), l_level.w );
   blit::screen.h_span( l_level.bl(), l_level.w+1 );
   blit::screen.v_span( l_level.tl(), l_level.h );
   blit::screen.v_span( l_level.tr(), l_level.h );
 
-  /* Add in the menu splash, fading in as we reach full zoom. */
-  blit::screen.blit( c_menu_splash, c_menu_splash->clip, 
-                     blit::Point(
-                      ( blit::screen.bounds.w - c_menu_splash->bounds.w ) / 2,
-                      ( blit::screen.bounds.h - c_menu_splash->bounds.h ) / 2
-                     )
-                    );
+  /* Add in the menu splash, fading in as we reach full zoom; in lores it */
+  /* needs shrinking to match.                                           */
+  uint8_t l_shrink = render_scale();
+  blit::screen.alpha = g_governor.fade( l_alpha, QUALITY_SOLID_SPLASH );
+  if ( ( 0 == blit::screen.alpha ) || ( nullptr == c_splash_sheet ) )
+  {
+    /* Nothing to see, so nothing to draw. */
+  }
+  else if ( 1 == l_shrink )
+  {
+    c_splash_sheet->blend( blit::Point(
+                            ( blit::screen.bounds.w - c_menu_splash->bounds.w ) / 2,
+                            ( blit::screen.bounds.h - c_menu_splash->bounds.h ) / 2
+                           ),
+                           blit::screen.alpha
+                          );
+  }
+  else
+  {
+    blit::screen.stretch_blit( c_menu_splash, c_menu_splash->clip,
+                               blit::Rect(
+                                ( blit::screen.bounds.w - c_menu_splash->bounds.w / l_shrink ) / 2,
+                                ( blit::screen.bounds.h - c_menu_splash->bounds.h / l_shrink ) / 2,
+                                c_menu_splash->bounds.w / l_shrink,
+                                c_menu_splash->bounds.h / l_shrink
+                               )
+                              );
+  }
 
   /* Reset the alpha to what it was before. */
   blit::screen.alpha = l_previous_alpha;
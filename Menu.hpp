@@ -13,6 +13,27 @@
 #define   _MENU_HPP_
 
 #include "32blit.hpp"
+#include "Game.hpp"
+#include "LevelPack.hpp"
+#include "RenderPool.hpp"
+#include "SpriteSheet.hpp"
+#include "ThumbCache.hpp"
+
+#define MENU_REPEAT_MS    200
+#define MENU_BROWSE_COLS  4
+#define MENU_BROWSE_ROWS  3
+#define MENU_BROWSE_PAGE  ( MENU_BROWSE_COLS * MENU_BROWSE_ROWS )
+#define MENU_WINDOWS      4
+
+/* The window a changed level is drawn from; the game's deltas keep it up */
+/* to date. Past MENU_WINDOWS changed levels, the rest share one more.    */
+
+typedef struct
+{
+  uint8_t        *tiles;
+  blit::TileMap  *map;
+  uint8_t         level;            /* zero if the window is free */
+} levelwindow_t;
 
 class Menu
 {
@@ -20,9 +41,24 @@ class Menu
     uint8_t         c_zoom;
     blit::Surface  *c_menu_sprites;
     blit::Surface  *c_menu_splash;
+    SpriteSheet    *c_splash_sheet;
     blit::TileMap  *c_menu_map;
     uint8_t        *c_menu_tiles;
     uint8_t         c_movetimer;
+    blit::Mat3      c_map_matrix;
+    scanline_t      c_map_scanline;
+    LevelPack      *c_pack;
+    ThumbCache     *c_thumbs;
+    bool            c_browsing;
+    uint16_t        c_pack_level;
+    uint16_t        c_pack_first;
+    Game           *c_game;
+    levelwindow_t   c_windows[MENU_WINDOWS+1];
+
+    levelwindow_t  *find_window( uint8_t );
+    levelwindow_t  *claim_window( uint8_t );
+    void            update_browser( void );
+    void            render_browser( void );
 
     blit::Rect      level_rect( uint8_t );
 
@@ -32,6 +68,13 @@ class Menu
     blit::Mat3      map_transform( uint8_t ); 
     void            update( uint32_t );
     void            render( uint32_t, uint8_t );
+    bool            pulsing( blit::Rect * );
+    void            set_pack( LevelPack * );
+    void            set_game( Game * );
+    void            sync( void );
+    blit::TileMap  *level_map( uint8_t );
+    bool            browsing( void );
+    uint32_t        signature( void );
 };
 
 #endif /* _MENU_HPP_ */
@@ -0,0 +1,185 @@
+/*
+ * Metatile.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The MetatileSet class; every distinct 2x2 block of tiles is given a one
+ * byte id, the first time it's seen. There are only ever a handful of them
+ * so a straight search is all that's needed to find one again. Like the
+ * rules, this has no reference to the 32blit API so that the host tools
+ * can use it as well.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstring>
+
+/* Local headers. */
+
+#include "Metatile.hpp"
+
+
+/* Functions. */
+
+/*
+ * metatile_block - fills in the four tiles of a block, from a 2x2 corner of
+ *                  a tile map with the given stride.
+ */
+
+static metatile_t metatile_block( const uint8_t *p_tiles, uint16_t p_stride )
+{
+  metatile_t l_block;
+
+  l_block.tiles[0] = p_tiles[0];
+  l_block.tiles[1] = p_tiles[1];
+  l_block.tiles[2] = p_tiles[p_stride];
+  l_block.tiles[3] = p_tiles[p_stride + 1];
+
+  /* All done. */
+  return l_block;
+}
+
+
+/*
+ * metatile_type - fills in the four tiles of a block for a tile type; that's
+ *                 the 16x16 square of the sheet with that tile at its top left.
+ */
+
+static metatile_t metatile_type( uint8_t p_type )
+{
+  metatile_t l_block;
+
+  l_block.tiles[0] = p_type;
+  l_block.tiles[1] = p_type + 1;
+  l_block.tiles[2] = p_type + METATILE_SHEET_W;
+  l_block.tiles[3] = p_type + METATILE_SHEET_W + 1;
+
+  /* All done. */
+  return l_block;
+}
+
+
+/*
+ * MetatileSet - constructor; starts out empty.
+ */
+
+MetatileSet::MetatileSet( void )
+{
+  memset( c_metatiles, 0, sizeof( c_metatiles ) );
+  c_count = 0;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * find - looks for a block (given as a 2x2 corner of a tile map, or a tile
+ *        type) in the set; returns its id, or -1 if it isn't there.
+ */
+
+int16_t MetatileSet::find( const uint8_t *p_tiles, uint16_t p_stride )
+{
+  metatile_t l_block = metatile_block( p_tiles, p_stride );
+
+  for ( uint8_t l_index = 0; l_index < c_count; l_index++ )
+  {
+    if ( 0 == memcmp( &c_metatiles[l_index], &l_block, sizeof( metatile_t ) ) )
+    {
+      return l_index;
+    }
+  }
+
+  /* Not one we know about. */
+  return -1;
+}
+
+int16_t MetatileSet::find( uint8_t p_type )
+{
+  metatile_t l_block = metatile_type( p_type );
+
+  return find( l_block.tiles, 2 );
+}
+
+
+/*
+ * add - finds a block in the set, adding it if it's new; returns its id, or
+ *       -1 if the set is already full.
+ */
+
+int16_t MetatileSet::add( const uint8_t *p_tiles, uint16_t p_stride )
+{
+  int16_t l_id = find( p_tiles, p_stride );
+
+  /* If we already have it, or have no room for it, we're done. */
+  if ( ( l_id >= 0 ) || ( c_count >= METATILE_MAX ) )
+  {
+    return l_id;
+  }
+
+  c_metatiles[c_count] = metatile_block( p_tiles, p_stride );
+  return c_count++;
+}
+
+int16_t MetatileSet::add( uint8_t p_type )
+{
+  metatile_t l_block = metatile_type( p_type );
+
+  return add( l_block.tiles, 2 );
+}
+
+
+/*
+ * count - returns how many blocks are in the set.
+ */
+
+uint8_t MetatileSet::count( void )
+{
+  /* Simple access method. */
+  return c_count;
+}
+
+
+/*
+ * tile - returns one of the four tiles of a block; corners are numbered
+ *        across and then down.
+ */
+
+uint8_t MetatileSet::tile( uint8_t p_id, uint8_t p_corner )
+{
+  return c_metatiles[p_id].tiles[p_corner % METATILE_TILES];
+}
+
+
+/*
+ * type - returns the tile type of a block, which is its top left tile; this
+ *        is what the rules work with.
+ */
+
+uint8_t MetatileSet::type( uint8_t p_id )
+{
+  return c_metatiles[p_id].tiles[0];
+}
+
+
+/*
+ * block - returns true if a block is a straight 16x16 square of the sheet,
+ *         which means it can be drawn in one go rather than tile by tile.
+ */
+
+bool MetatileSet::block( uint8_t p_id )
+{
+  uint8_t    l_type = c_metatiles[p_id].tiles[0];
+  metatile_t l_square = metatile_type( l_type );
+
+  /* It mustn't wrap around the edges of the sheet, either. */
+  return ( ( l_type % METATILE_SHEET_W ) < ( METATILE_SHEET_W - 1 ) ) &&
+         ( l_type < 256 - METATILE_SHEET_W ) &&
+         ( 0 == memcmp( &c_metatiles[p_id], &l_square, sizeof( metatile_t ) ) );
+}
+
+
+/* End of file Metatile.cpp */
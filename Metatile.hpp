@@ -0,0 +1,50 @@
+/*
+ * Metatile.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The game works in cells two tiles square; a MetatileSet collects every
+ * distinct 2x2 block of tiles the levels use, so that a level can be held
+ * as one byte per cell rather than four. Most blocks are a straight 16x16
+ * square of the spritesheet, and so can be drawn in a single go.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _METATILE_HPP_
+#define   _METATILE_HPP_
+
+#include <cstdint>
+
+#define METATILE_MAX        64
+#define METATILE_TILES      4
+#define METATILE_SHEET_W    16      /* tiles across the spritesheet */
+
+/* The four tiles of a block; top left, top right, bottom left, bottom right. */
+
+typedef struct
+{
+  uint8_t         tiles[METATILE_TILES];
+} metatile_t;
+
+class MetatileSet
+{
+  private:
+    metatile_t      c_metatiles[METATILE_MAX];
+    uint8_t         c_count;
+
+  public:
+                    MetatileSet( void );
+    int16_t         find( const uint8_t *, uint16_t );
+    int16_t         find( uint8_t );
+    int16_t         add( const uint8_t *, uint16_t );
+    int16_t         add( uint8_t );
+    uint8_t         count( void );
+    uint8_t         tile( uint8_t, uint8_t );
+    uint8_t         type( uint8_t );
+    bool            block( uint8_t );
+};
+
+#endif /* _METATILE_HPP_ */
+
+/* End of file Metatile.hpp */
@@ -20,24 +20,44 @@
 #include "sokoblit.hpp"
 
 #include "Player.hpp"
-#include "assets_font.hpp"
+#include "Trace.hpp"
+#include "Tween.hpp"
 
 
 /* Functions. */
 
 /*
  * Player - constructor, basic initialisation. Takes the co-ordinates of the
- *          starting location, in tiles.
+ *          starting location, in tiles, and the (shared) font to count with.
  */
 
-Player::Player( uint16_t p_x, uint16_t p_y )
+Player::Player( uint16_t p_x, uint16_t p_y, blit::Font *p_font )
 {
-  /* Save the location we've been given. */
-  c_location.x = p_x;
-  c_location.y = p_y;
+  /* Save the location we've been given, so we can always go back there. */
+  c_start.x = p_x;
+  c_start.y = p_y;
 
-  /* Load the font we use to count progress. */
-  c_font = new blit::Font( a_font );
+  /* Remember the font we use to count progress. */
+  c_font = p_font;
+
+  /* And set everything else up from the start. */
+  reset();
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * reset - puts the player back where they started, with the clock and move
+ *         counter back at zero.
+ */
+
+void Player::reset( void )
+{
+  /* Back to the start, stopping any movement that was underway. */
+  g_tweener.cancel( &c_steps );
+  c_location = c_start;
 
   /* And set some defaults. */
   c_direction = DIR_DOWN;
@@ -45,8 +65,12 @@ Player::Player( uint16_t p_x, uint16_t p_y )
   c_steps = 0;
   c_blocked = false;
   c_pushing = false;
+  c_moves = 0;
+  c_deciseconds = 0;
+  c_milliseconds = 0;
+  c_clock_time = 0;
 
-  /* All done! */
+  /* All done. */
   return;
 }
 
@@ -84,6 +108,17 @@ bool Player::pushing( void )
 }
 
 
+/*
+ * moves - returns how many moves the player has made on this level.
+ */
+
+uint16_t Player::moves( void )
+{
+  /* Pretty simple access method. */
+  return c_moves;
+}
+
+
 /*
  * direction - which way is the player facing?
  */
@@ -95,16 +130,16 @@ direction_t Player::facing( void )
 
 
 /*
- * render - draws the player onto the screen; assumes that the screen has an
- *          appropriate spritesheet with sprites in the right place!
+ * render - adds the player (and any crate being pushed) to the sprite batch;
+ *          assumes that the sheet has sprites in the right place!
  */
 
-void Player::render( void )
+void Player::render( SpriteBatch *p_batch )
 {
+  TRACE_SCOPE( "Player::render" );
   blit::Rect  l_sprite = blit::Rect( 0, 4, 2, 2 );
   blit::Point l_location = c_location * 8;
   blit::Point l_crate_loc;
-  char        l_buffer[32];
 
   /* Work out the correct rectangle to blit, based on the direction. Also the */
   /* precise location is offset if we're still moving.                        */
@@ -148,15 +183,30 @@ void Player::render( void )
   l_sprite.x += ( ( c_steps % 3 ) * 2 );
 
   /* And just send the right sprite to the right location. */
-  blit::screen.sprite( l_sprite, l_location );
+  p_batch->add( LAYER_PLAYER, l_sprite, l_location );
 
   /* And the crate, if we're pushing that. */
   if ( c_pushing )
   {
-    blit::screen.sprite( blit::Rect( 4, 0, 2, 2 ), l_crate_loc );
+    p_batch->add( LAYER_CRATE, blit::Rect( 4, 0, 2, 2 ), l_crate_loc );
   }
 
-  /* Lastly, write the current time and number of moves to the top. */
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_status - writes the current time and number of moves to the top of
+ *                 the screen.
+ */
+
+void Player::render_status( void )
+{
+  TRACE_SCOPE( "Player::render_status" );
+  char        l_buffer[32];
+
+  /* Use a nice bright pen, to stand out. */
   blit::screen.pen = blit::Pen( 154, 235, 0, 255 );
   snprintf( l_buffer, 30, "Time:%02d:%02d.%d", 
             c_deciseconds / 600, 
@@ -174,40 +224,24 @@ void Player::render( void )
 
 
 /*
- * update - called every tick to keep the animation running and location 
- *          changing when the player is moving.
+ * update - called every tick while the player is active, to keep the clock
+ *          running; the movement itself is animated by the tweener.
  */
 
-void Player::update( void )
+void Player::update( uint32_t p_time )
 {
-  static uint8_t l_delay = 2;
-  static uint8_t l_count = 10;
-
-  /* Horrible hack here to keep time, in tenths of seconds, without getting */
-  /* into complications about whether or not we're active.                  */
-  if ( l_count > 0 )
+  /* Keep time in tenths of seconds; only count time we've seen, so that */
+  /* any gap where we weren't active doesn't get charged to the player.  */
+  if ( ( 0 != c_clock_time ) && ( ( p_time - c_clock_time ) < PLAYER_CLOCK_GAP ) )
   {
-    l_count--;
-  }
-  else
-  {
-    c_deciseconds++;
-    l_count = 10;
-  }
-
-  if ( l_delay > 0 )
-  {
-    l_delay--;
-    return;
-  }
-  l_delay = 2;
-
-  /* Only need to do stuff if the steps are there. */
-  if ( c_steps > 0 )
-  {
-    /* Just decrement the steps. */
-    c_steps -= 2;
+    c_milliseconds += p_time - c_clock_time;
+    while ( c_milliseconds >= 100 )
+    {
+      c_deciseconds++;
+      c_milliseconds -= 100;
+    }
   }
+  c_clock_time = p_time;
 
   /* If we've reached the end of the movement, clear the blocked flag. */
   if ( 0 == c_steps )
@@ -232,6 +266,26 @@ blit::Point Player::location( void )
 }
 
 
+/*
+ * signature - boils down everything about the player that affects what we
+ *             draw into a single value, so that changes are easy to spot.
+ */
+
+uint32_t Player::signature( void )
+{
+  uint32_t l_signature = c_location.x;
+
+  l_signature = ( l_signature * 31 ) + c_location.y;
+  l_signature = ( l_signature * 31 ) + c_direction;
+  l_signature = ( l_signature * 31 ) + c_steps;
+  l_signature = ( l_signature * 31 ) + ( c_blocked ? 1 : 0 ) + ( c_pushing ? 2 : 0 );
+  l_signature = ( l_signature * 31 ) + c_moves;
+  l_signature = ( l_signature * 31 ) + c_deciseconds;
+
+  return l_signature;
+}
+
+
 /*
  * move - starts the player moving in the direction specified. If the blocked
  *        flag is true, we run the animation but simply don't move.
@@ -285,6 +339,9 @@ void Player::move( direction_t p_direction, bool p_blocked, bool p_pushing )
   c_blocked = p_blocked;
   c_pushing = p_pushing;
 
+  /* And let the tweener walk us there. */
+  g_tweener.start( &c_steps, 0, PLAYER_STEP_MS, EASE_LINEAR );
+
   /* All done. */
   return;
 }
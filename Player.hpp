@@ -14,22 +14,18 @@
 
 #include "32blit.hpp"
 #include "sokoblit.hpp"
+#include "Rules.hpp"
+#include "SpriteBatch.hpp"
 
 #define ANIMATION_FRAMES  3
-
-typedef enum
-{
-  DIR_NONE,
-  DIR_DOWN,
-  DIR_LEFT,
-  DIR_UP,
-  DIR_RIGHT
-} direction_t;
+#define PLAYER_STEP_MS    240     /* time to walk one (2x2) cell */
+#define PLAYER_CLOCK_GAP  100     /* longer than this between updates, we were away */
 
 class Player
 {
   private:
     blit::Point   c_location;
+    blit::Point   c_start;
     direction_t   c_direction;
     uint8_t       c_animation;
     uint8_t       c_steps;
@@ -37,17 +33,23 @@ class Player
     bool          c_pushing;
     uint16_t      c_moves;
     uint32_t      c_deciseconds;
+    uint16_t      c_milliseconds;
+    uint32_t      c_clock_time;
     blit::Font   *c_font;
 
   public:
-                  Player( uint16_t, uint16_t );
+                  Player( uint16_t, uint16_t, blit::Font * );
                  ~Player( void );
+    void          reset( void );
     bool          moving( void );
     bool          pushing( void );
-    void          render( void );
-    void          update( void );
+    uint16_t      moves( void );
+    void          render( SpriteBatch * );
+    void          render_status( void );
+    void          update( uint32_t );
     blit::Point   location( void );
     direction_t   facing( void );
+    uint32_t      signature( void );
     void          move( direction_t, bool, bool );
 };
 
@@ -0,0 +1,262 @@
+/*
+ * RenderPool.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The RenderPool draws tilemaps across several threads on the host build;
+ * each scanline is transformed on its own, so the viewport can be cut into
+ * horizontal bands and each band drawn by a different core. The workers are
+ * started once, and wait around between frames.
+ *
+ * On device (or without SOKOBLIT_THREADED_RENDER) it just draws the map.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstdlib>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "RenderPool.hpp"
+
+
+/* Module variables. */
+
+RenderPool g_renderpool;
+
+
+/* Functions. */
+
+/*
+ * RenderPool - constructor; works out how many workers we can use, but they
+ *              aren't started until the first draw. The environment can ask
+ *              for fewer, down to none at all.
+ */
+
+RenderPool::RenderPool( void )
+{
+  c_workers = 0;
+  c_enabled = false;
+
+#ifdef RENDERPOOL_THREADS
+  /* Work out how many we want before clamping, so that nothing big */
+  /* wraps around on its way into the worker count.                 */
+  uint32_t      l_cores = std::thread::hardware_concurrency();
+  unsigned long l_workers = ( l_cores > 1 ) ? l_cores - 1 : 0;
+  if ( nullptr != getenv( RENDERPOOL_ENV ) )
+  {
+    l_workers = strtoul( getenv( RENDERPOOL_ENV ), nullptr, 10 );
+  }
+  if ( l_workers > RENDERPOOL_MAX_WORKERS )
+  {
+    l_workers = RENDERPOOL_MAX_WORKERS;
+  }
+  c_workers = l_workers;
+  c_enabled = ( c_workers > 0 );
+
+  c_generation = 0;
+  c_pending = 0;
+  c_started = false;
+  c_stopping = false;
+  c_map = nullptr;
+  c_dest = nullptr;
+  c_scanline = nullptr;
+  c_bands = 0;
+#endif /* RENDERPOOL_THREADS */
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * ~RenderPool - destructor; lets any workers know it's time to go home, and
+ *               waits for them to leave.
+ */
+
+RenderPool::~RenderPool( void )
+{
+#ifdef RENDERPOOL_THREADS
+  if ( c_started )
+  {
+    {
+      std::lock_guard<std::mutex> l_guard( c_lock );
+      c_stopping = true;
+    }
+    c_wake.notify_all();
+    for ( uint8_t l_worker = 0; l_worker < c_workers; l_worker++ )
+    {
+      c_threads[l_worker].join();
+    }
+  }
+#endif /* RENDERPOOL_THREADS */
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * enable - switches between drawing across the workers, and drawing on just
+ *          the calling thread; handy for checking that they agree.
+ */
+
+void RenderPool::enable( bool p_enabled )
+{
+  c_enabled = p_enabled && ( c_workers > 0 );
+  return;
+}
+
+
+/*
+ * enabled - returns true if we're drawing across the workers.
+ */
+
+bool RenderPool::enabled( void )
+{
+  /* Simple access method. */
+  return c_enabled;
+}
+
+
+/*
+ * threads - returns how many threads a draw is spread across.
+ */
+
+uint8_t RenderPool::threads( void )
+{
+  return c_enabled ? c_workers + 1 : 1;
+}
+
+
+#ifdef RENDERPOOL_THREADS
+
+/*
+ * start - sets the workers going, each waiting for its first job.
+ */
+
+void RenderPool::start( void )
+{
+  for ( uint8_t l_worker = 0; l_worker < c_workers; l_worker++ )
+  {
+    c_threads[l_worker] = std::thread( &RenderPool::work, this, l_worker );
+  }
+  c_started = true;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * band - returns the part of the viewport that a given band covers; the
+ *        scanlines are shared out as evenly as they'll go.
+ */
+
+blit::Rect RenderPool::band( uint8_t p_band )
+{
+  int32_t l_top = c_viewport.y + ( c_viewport.h * p_band ) / c_bands;
+  int32_t l_bottom = c_viewport.y + ( c_viewport.h * ( p_band + 1 ) ) / c_bands;
+
+  return blit::Rect( c_viewport.x, l_top, c_viewport.w, l_bottom - l_top );
+}
+
+
+/*
+ * work - the body of each worker; wait for a new job, draw our band of it
+ *        (if there is one for us) and report back.
+ */
+
+void RenderPool::work( uint8_t p_worker )
+{
+  uint32_t l_generation = 0;
+
+  while ( true )
+  {
+    {
+      std::unique_lock<std::mutex> l_guard( c_lock );
+      c_wake.wait( l_guard, [&]{ return c_stopping || ( c_generation != l_generation ); } );
+      if ( c_stopping )
+      {
+        return;
+      }
+      l_generation = c_generation;
+    }
+
+    /* The caller draws band 0, so we take the one after our number. */
+    if ( p_worker + 1 < c_bands )
+    {
+      c_map->draw( c_dest, band( p_worker + 1 ), *c_scanline );
+    }
+
+    {
+      std::lock_guard<std::mutex> l_guard( c_lock );
+      c_pending--;
+    }
+    c_done.notify_one();
+  }
+}
+
+#endif /* RENDERPOOL_THREADS */
+
+
+/*
+ * draw - draws the tilemap into the viewport; spread across the workers if
+ *        we're allowed and it's big enough to be worth it, or straight
+ *        through on this thread if not. Either way, it's finished by the
+ *        time we return.
+ */
+
+void RenderPool::draw( blit::TileMap *p_map, blit::Surface *p_dest, blit::Rect p_viewport, const scanline_t &p_scanline )
+{
+#ifdef RENDERPOOL_THREADS
+  uint8_t l_bands = 1 + c_workers;
+  if ( p_viewport.h / RENDERPOOL_MIN_BAND < l_bands )
+  {
+    l_bands = p_viewport.h / RENDERPOOL_MIN_BAND;
+  }
+
+  if ( c_enabled && ( l_bands > 1 ) )
+  {
+    if ( !c_started )
+    {
+      start();
+    }
+
+    /* Hand out the job, and wake everyone up. */
+    {
+      std::lock_guard<std::mutex> l_guard( c_lock );
+      c_map = p_map;
+      c_dest = p_dest;
+      c_viewport = p_viewport;
+      c_scanline = &p_scanline;
+      c_bands = l_bands;
+      c_pending = c_workers;
+      c_generation++;
+    }
+    c_wake.notify_all();
+
+    /* Do our own share, and then wait for the others to finish theirs. */
+    p_map->draw( p_dest, band( 0 ), p_scanline );
+
+    std::unique_lock<std::mutex> l_guard( c_lock );
+    c_done.wait( l_guard, [&]{ return 0 == c_pending; } );
+    return;
+  }
+#endif /* RENDERPOOL_THREADS */
+
+  /* Just the one thread, then. */
+  p_map->draw( p_dest, p_viewport, p_scanline );
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file RenderPool.cpp */
@@ -0,0 +1,75 @@
+/*
+ * RenderPool.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The RenderPool draws tilemaps across several threads on the host build;
+ * each scanline is transformed on its own, so the viewport can be cut into
+ * horizontal bands and each band drawn by a different core. The workers are
+ * started once, and wait around between frames.
+ *
+ * On device (or without SOKOBLIT_THREADED_RENDER) it just draws the map.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _RENDERPOOL_HPP_
+#define   _RENDERPOOL_HPP_
+
+#include "32blit.hpp"
+
+#if defined( SOKOBLIT_THREADED_RENDER ) && !defined( TARGET_32BLIT_HW )
+#define RENDERPOOL_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#define RENDERPOOL_MAX_WORKERS  7
+#define RENDERPOOL_MIN_BAND     8       /* fewest scanlines worth a thread */
+#define RENDERPOOL_ENV          "SOKOBLIT_RENDER_THREADS"
+
+typedef std::function<blit::Mat3(uint8_t)> scanline_t;
+
+class RenderPool
+{
+  private:
+    uint8_t                   c_workers;
+    bool                      c_enabled;
+
+#ifdef RENDERPOOL_THREADS
+    std::thread               c_threads[RENDERPOOL_MAX_WORKERS];
+    std::mutex                c_lock;
+    std::condition_variable   c_wake;
+    std::condition_variable   c_done;
+    uint32_t                  c_generation;
+    uint8_t                   c_pending;
+    bool                      c_started;
+    bool                      c_stopping;
+
+    /* The job in hand, shared by all the workers. */
+    blit::TileMap            *c_map;
+    blit::Surface            *c_dest;
+    blit::Rect                c_viewport;
+    const scanline_t         *c_scanline;
+    uint8_t                   c_bands;
+
+    void                      start( void );
+    void                      work( uint8_t );
+    blit::Rect                band( uint8_t );
+#endif /* RENDERPOOL_THREADS */
+
+  public:
+                              RenderPool( void );
+                             ~RenderPool( void );
+    void                      enable( bool );
+    bool                      enabled( void );
+    uint8_t                   threads( void );
+    void                      draw( blit::TileMap *, blit::Surface *, blit::Rect, const scanline_t & );
+};
+
+extern RenderPool g_renderpool;
+
+#endif /* _RENDERPOOL_HPP_ */
+
+/* End of file RenderPool.hpp */
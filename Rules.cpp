@@ -0,0 +1,106 @@
+/*
+ * Rules.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The rules of moving around a level: what a move into a cell does, and how
+ * a cell changes when a crate arrives or leaves. These only deal in tile
+ * numbers, with no reference to the 32blit API, so that the host tools can
+ * check them directly against a reference model.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* Local headers. */
+
+#include "Rules.hpp"
+
+
+/* Functions. */
+
+/*
+ * rules_step - works out how far (in tiles) a single move in the given
+ *              direction takes you.
+ */
+
+void rules_step( direction_t p_direction, int8_t *p_dx, int8_t *p_dy )
+{
+  *p_dx = 0;
+  *p_dy = 0;
+
+  switch( p_direction )
+  {
+    case DIR_DOWN:
+      *p_dy = RULES_CELL;
+      break;
+    case DIR_LEFT:
+      *p_dx = -RULES_CELL;
+      break;
+    case DIR_UP:
+      *p_dy = -RULES_CELL;
+      break;
+    case DIR_RIGHT:
+      *p_dx = RULES_CELL;
+      break;
+    case DIR_NONE:
+      break;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * rules_check - decides what happens when the player moves into a cell,
+ *               given the tile there and the tile in the cell beyond it.
+ */
+
+rule_t rules_check( uint8_t p_target, uint8_t p_beyond )
+{
+  /* Walls stop you dead. */
+  if ( TILED_WALL == p_target )
+  {
+    return RULE_BLOCKED;
+  }
+
+  /* Crates move if there's free space behind them, otherwise they're */
+  /* just like walking into a wall.                                   */
+  if ( TILED_CRATE == p_target )
+  {
+    if ( ( TILED_WALL == p_beyond ) || ( TILED_CRATE == p_beyond ) )
+    {
+      return RULE_BLOCKED;
+    }
+    return RULE_PUSH;
+  }
+
+  /* Anything else, you just walk onto. */
+  return RULE_WALK;
+}
+
+
+/*
+ * rules_cell - works out what a cell becomes when it's given a tile type.
+ *              RESET is a special case, which puts back whatever the map
+ *              originally had there - unless that was a crate, which has
+ *              since moved and so leaves an empty floor behind. Returns the
+ *              type to use, which is still RESET if the original should go
+ *              back exactly as it was.
+ */
+
+uint8_t rules_cell( uint8_t p_original, uint8_t p_type )
+{
+  /* A crate never comes back to where it started by itself. */
+  if ( ( TILED_RESET == p_type ) && ( TILED_CRATE == p_original ) )
+  {
+    return TILED_EMPTY;
+  }
+
+  /* All done. */
+  return p_type;
+}
+
+
+/* End of file Rules.cpp */
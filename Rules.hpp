@@ -0,0 +1,54 @@
+/*
+ * Rules.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The rules of moving around a level: what a move into a cell does, and how
+ * a cell's tiles are rewritten when a crate arrives or leaves. These only
+ * deal in tile numbers, with no reference to the 32blit API, so that the
+ * host tools can check them directly against a reference model.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _RULES_HPP_
+#define   _RULES_HPP_
+
+#include <cstdint>
+
+/* Constants based on tiled tiles - tinker at your peril! */
+
+#define TILED_RESET       0
+#define TILED_WALL        2
+#define TILED_CRATE       4
+#define TILED_EMPTY       34
+#define TILED_CRATE_HOME  36
+#define TILED_PLAYER_HOME 76
+
+/* Each cell of a level is two tiles square. */
+
+#define RULES_CELL        2
+
+typedef enum
+{
+  DIR_NONE,
+  DIR_DOWN,
+  DIR_LEFT,
+  DIR_UP,
+  DIR_RIGHT
+} direction_t;
+
+typedef enum
+{
+  RULE_WALK,
+  RULE_PUSH,
+  RULE_BLOCKED
+} rule_t;
+
+void        rules_step( direction_t, int8_t *, int8_t * );
+rule_t      rules_check( uint8_t, uint8_t );
+uint8_t     rules_cell( uint8_t, uint8_t );
+
+#endif /* _RULES_HPP_ */
+
+/* End of file Rules.hpp */
@@ -0,0 +1,118 @@
+/*
+ * SpriteBatch.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The SpriteBatch collects up all the dynamic sprites for a frame (players,
+ * crates on the move, markers and so on) and draws them in one go; sorted by
+ * layer, and then by where they live in the sheet so that neighbouring draws
+ * read from neighbouring memory.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "SpriteBatch.hpp"
+
+
+/* Functions. */
+
+/*
+ * SpriteBatch - constructor, which starts empty and with no sheet.
+ */
+
+SpriteBatch::SpriteBatch( void )
+{
+  c_sheet = nullptr;
+  c_count = 0;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * begin - starts a new batch, drawing from the sheet given; anything still
+ *         waiting from before is thrown away.
+ */
+
+void SpriteBatch::begin( SpriteSheet *p_sheet )
+{
+  c_sheet = p_sheet;
+  c_count = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * add - queues up a sprite (a Rect of tiles in the sheet) to be drawn at the
+ *       given location, on the given layer. If the batch is full, what we
+ *       have so far is drawn to make room.
+ */
+
+void SpriteBatch::add( layer_t p_layer, blit::Rect p_tiles, blit::Point p_location )
+{
+  /* Make room if we need to. */
+  if ( c_count >= SPRITEBATCH_MAX )
+  {
+    flush();
+  }
+
+  /* The sort key is the layer, then the tile's position in the sheet. */
+  c_sprites[c_count].key = ( p_layer << 8 ) | ( ( p_tiles.y * 16 + p_tiles.x ) & 0xFF );
+  c_sprites[c_count].tiles = p_tiles;
+  c_sprites[c_count].location = p_location;
+  c_count++;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * flush - sorts everything we've collected and draws it. It's an insertion
+ *         sort, which is stable (so equal keys keep the order they were added
+ *         in) and about as quick as anything for the handful we hold.
+ */
+
+void SpriteBatch::flush( void )
+{
+  /* Sort into drawing order. */
+  for ( uint8_t l_index = 1; l_index < c_count; l_index++ )
+  {
+    batched_t l_sprite = c_sprites[l_index];
+    int16_t   l_slot = l_index - 1;
+
+    while ( ( l_slot >= 0 ) && ( c_sprites[l_slot].key > l_sprite.key ) )
+    {
+      c_sprites[l_slot + 1] = c_sprites[l_slot];
+      l_slot--;
+    }
+    c_sprites[l_slot + 1] = l_sprite;
+  }
+
+  /* And draw them all. */
+  if ( nullptr != c_sheet )
+  {
+    for ( uint8_t l_index = 0; l_index < c_count; l_index++ )
+    {
+      c_sheet->sprite( c_sprites[l_index].tiles, c_sprites[l_index].location );
+    }
+  }
+  c_count = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file SpriteBatch.cpp */
@@ -0,0 +1,55 @@
+/*
+ * SpriteBatch.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The SpriteBatch collects up all the dynamic sprites for a frame (players,
+ * crates on the move, markers and so on) and draws them in one go; sorted by
+ * layer, and then by where they live in the sheet so that neighbouring draws
+ * read from neighbouring memory.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _SPRITEBATCH_HPP_
+#define   _SPRITEBATCH_HPP_
+
+#include "32blit.hpp"
+#include "SpriteSheet.hpp"
+
+#define SPRITEBATCH_MAX     32
+
+/* Layers are drawn in order, so later ones end up on top. */
+
+typedef enum
+{
+  LAYER_CRATE,
+  LAYER_PLAYER,
+  LAYER_MARKER,
+  LAYER_MAX
+} layer_t;
+
+typedef struct
+{
+  uint16_t        key;
+  blit::Rect      tiles;
+  blit::Point     location;
+} batched_t;
+
+class SpriteBatch
+{
+  private:
+    SpriteSheet    *c_sheet;
+    batched_t       c_sprites[SPRITEBATCH_MAX];
+    uint8_t         c_count;
+
+  public:
+                    SpriteBatch( void );
+    void            begin( SpriteSheet * );
+    void            add( layer_t, blit::Rect, blit::Point );
+    void            flush( void );
+};
+
+#endif /* _SPRITEBATCH_HPP_ */
+
+/* End of file SpriteBatch.hpp */
@@ -0,0 +1,341 @@
+/*
+ * SpriteSheet.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The SpriteSheet class wraps up a loaded spritesheet; if native sheets are
+ * enabled, it converts the sheet once into the screen's own pixel format so
+ * that unscaled, opaque drawing becomes a straight copy rather than paying
+ * for a format conversion on every pixel.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <algorithm>
+#include <cstring>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Arena.hpp"
+#include "Blend.hpp"
+#include "SpriteSheet.hpp"
+
+
+/* Functions. */
+
+/*
+ * SpriteSheet - constructor; takes an already loaded surface and, if we're
+ *               using native sheets, converts it up front.
+ */
+
+SpriteSheet::SpriteSheet( blit::Surface *p_surface )
+{
+  /* Remember the surface, which is what we fall back on. */
+  c_surface = p_surface;
+  c_pixels = nullptr;
+  c_alpha = nullptr;
+  memset( c_fill, SHEET_MIXED, sizeof( c_fill ) );
+
+#ifdef SOKOBLIT_NATIVE_SHEETS
+  /* Only formats we understand can be converted. */
+  if ( ( nullptr == c_surface ) ||
+       ( ( blit::PixelFormat::P != c_surface->format ) &&
+         ( blit::PixelFormat::RGBA != c_surface->format ) &&
+         ( blit::PixelFormat::RGB != c_surface->format ) ) )
+  {
+    return;
+  }
+
+  /* Grab enough room for the RGB data, and the alpha after it. */
+  uint32_t l_count = c_surface->bounds.w * c_surface->bounds.h;
+  uint8_t *l_block = (uint8_t *)g_arena.alloc( SHEET_NATIVE_BYTES( c_surface->bounds.w, c_surface->bounds.h ),
+                                               ARENA_SPRITES );
+  if ( nullptr == l_block )
+  {
+    /* Then we just won't be native; not the end of the world. */
+    return;
+  }
+  c_pixels = l_block;
+  c_alpha = l_block + ( l_count * 3 );
+
+  /* Convert every pixel, once. */
+  for ( uint32_t l_index = 0; l_index < l_count; l_index++ )
+  {
+    blit::Pen l_pen;
+    switch( c_surface->format )
+    {
+      case blit::PixelFormat::P:
+        l_pen = c_surface->palette[c_surface->data[l_index]];
+        break;
+      case blit::PixelFormat::RGBA:
+        l_pen = ( (blit::Pen *)c_surface->data )[l_index];
+        break;
+      default:
+        l_pen = blit::Pen( c_surface->data[l_index*3], c_surface->data[l_index*3+1],
+                           c_surface->data[l_index*3+2] );
+        break;
+    }
+    c_pixels[l_index*3]   = l_pen.r;
+    c_pixels[l_index*3+1] = l_pen.g;
+    c_pixels[l_index*3+2] = l_pen.b;
+    c_alpha[l_index] = l_pen.a;
+  }
+
+  /* And then work out which tiles are entirely solid (or empty), so that */
+  /* we know which can be copied wholesale.                               */
+  uint16_t l_columns = c_surface->bounds.w / SHEET_TILE_SIZE;
+  uint16_t l_tiles = l_columns * ( c_surface->bounds.h / SHEET_TILE_SIZE );
+  for ( uint16_t l_tile = 0; l_tile < l_tiles && l_tile < SHEET_TILE_MAX; l_tile++ )
+  {
+    uint32_t l_origin = ( ( l_tile / l_columns ) * SHEET_TILE_SIZE * c_surface->bounds.w ) +
+                        ( ( l_tile % l_columns ) * SHEET_TILE_SIZE );
+    uint16_t l_solid = 0, l_clear = 0;
+
+    for ( uint8_t y = 0; y < SHEET_TILE_SIZE; y++ )
+    {
+      for ( uint8_t x = 0; x < SHEET_TILE_SIZE; x++ )
+      {
+        uint8_t l_alpha = c_alpha[l_origin + ( y * c_surface->bounds.w ) + x];
+        if ( 255 == l_alpha ) l_solid++;
+        if ( 0 == l_alpha ) l_clear++;
+      }
+    }
+
+    if ( ( SHEET_TILE_SIZE * SHEET_TILE_SIZE ) == l_solid )
+    {
+      c_fill[l_tile] = SHEET_OPAQUE;
+    }
+    else if ( ( SHEET_TILE_SIZE * SHEET_TILE_SIZE ) == l_clear )
+    {
+      c_fill[l_tile] = SHEET_TRANSPARENT;
+    }
+  }
+#endif /* SOKOBLIT_NATIVE_SHEETS */
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * surface - returns the underlying (unconverted) surface.
+ */
+
+blit::Surface *SpriteSheet::surface( void )
+{
+  /* Simple access method. */
+  return c_surface;
+}
+
+
+/*
+ * native - decides if we can use the native fast path right now; we need
+ *          to have converted the sheet, the screen needs to be in the format
+ *          we converted to, and we can't be blending the whole thing.
+ */
+
+bool SpriteSheet::native( void )
+{
+  return ( nullptr != c_pixels ) &&
+         ( blit::PixelFormat::RGB == blit::screen.format ) &&
+         ( 255 == blit::screen.alpha );
+}
+
+
+/*
+ * copy - draws a single tile from the native sheet onto the screen, clipped
+ *        to the screen's clip rectangle. Opaque tiles are straight copies,
+ *        anything else has to look at the alpha of each pixel.
+ */
+
+void SpriteSheet::copy( blit::Rect p_source, blit::Point p_dest )
+{
+  uint8_t l_fill = c_fill[( p_source.y / SHEET_TILE_SIZE ) * ( c_surface->bounds.w / SHEET_TILE_SIZE ) +
+                          ( p_source.x / SHEET_TILE_SIZE )];
+
+  /* Nothing to draw is the fastest path of all. */
+  if ( SHEET_TRANSPARENT == l_fill )
+  {
+    return;
+  }
+
+  /* Clip what we're drawing against the screen. */
+  const blit::Rect &l_clip = blit::screen.clip;
+  int32_t l_left = std::max( p_dest.x, l_clip.x );
+  int32_t l_top = std::max( p_dest.y, l_clip.y );
+  int32_t l_right = std::min( p_dest.x + p_source.w, l_clip.x + l_clip.w );
+  int32_t l_bottom = std::min( p_dest.y + p_source.h, l_clip.y + l_clip.h );
+  if ( ( l_left >= l_right ) || ( l_top >= l_bottom ) )
+  {
+    return;
+  }
+
+  /* Now work through each line. */
+  int32_t l_width = l_right - l_left;
+  for ( int32_t y = l_top; y < l_bottom; y++ )
+  {
+    uint32_t l_src = ( ( p_source.y + y - p_dest.y ) * c_surface->bounds.w ) + ( p_source.x + l_left - p_dest.x );
+    uint8_t *l_dst = blit::screen.data + ( ( y * blit::screen.bounds.w ) + l_left ) * 3;
+
+    /* Opaque lines are just copied. */
+    if ( SHEET_OPAQUE == l_fill )
+    {
+      memcpy( l_dst, c_pixels + ( l_src * 3 ), l_width * 3 );
+      continue;
+    }
+
+    /* Otherwise, we need to check (and possibly blend) every pixel. */
+    for ( int32_t x = 0; x < l_width; x++, l_src++, l_dst += 3 )
+    {
+      uint8_t l_alpha = c_alpha[l_src];
+      const uint8_t *l_pixel = c_pixels + ( l_src * 3 );
+      if ( 255 == l_alpha )
+      {
+        l_dst[0] = l_pixel[0];
+        l_dst[1] = l_pixel[1];
+        l_dst[2] = l_pixel[2];
+      }
+      else if ( 0 != l_alpha )
+      {
+        l_dst[0] = ( l_pixel[0] * l_alpha + l_dst[0] * ( 255 - l_alpha ) ) / 255;
+        l_dst[1] = ( l_pixel[1] * l_alpha + l_dst[1] * ( 255 - l_alpha ) ) / 255;
+        l_dst[2] = ( l_pixel[2] * l_alpha + l_dst[2] * ( 255 - l_alpha ) ) / 255;
+      }
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * tile - draws a single 8x8 tile at the screen location given.
+ */
+
+void SpriteSheet::tile( uint8_t p_tile, blit::Point p_dest )
+{
+  uint16_t   l_columns = c_surface->bounds.w / SHEET_TILE_SIZE;
+  blit::Rect l_source = blit::Rect( ( p_tile % l_columns ) * SHEET_TILE_SIZE,
+                                    ( p_tile / l_columns ) * SHEET_TILE_SIZE,
+                                    SHEET_TILE_SIZE, SHEET_TILE_SIZE );
+
+  /* If we can't go native, let the screen do the work. */
+  if ( !native() )
+  {
+    blit::screen.sprites = c_surface;
+    blit::screen.sprite( blit::Rect( p_tile % l_columns, p_tile / l_columns, 1, 1 ), p_dest );
+    return;
+  }
+
+  /* Otherwise, it's a straight copy. */
+  copy( l_source, p_dest );
+  return;
+}
+
+
+/*
+ * sprite - draws a sprite from the sheet, with the size and location of the
+ *          sprite given in tiles (just like blit::Surface::sprite)
+ */
+
+void SpriteSheet::sprite( blit::Rect p_sprite, blit::Point p_dest )
+{
+  /* If we can't go native, let the screen do the work. */
+  if ( !native() )
+  {
+    blit::screen.sprites = c_surface;
+    blit::screen.sprite( p_sprite, p_dest );
+    return;
+  }
+
+  /* Otherwise, just copy over each tile in turn. */
+  for ( int32_t y = 0; y < p_sprite.h; y++ )
+  {
+    for ( int32_t x = 0; x < p_sprite.w; x++ )
+    {
+      copy( blit::Rect( ( p_sprite.x + x ) * SHEET_TILE_SIZE, ( p_sprite.y + y ) * SHEET_TILE_SIZE,
+                        SHEET_TILE_SIZE, SHEET_TILE_SIZE ),
+            p_dest + blit::Point( x * SHEET_TILE_SIZE, y * SHEET_TILE_SIZE ) );
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blend - draws the whole sheet as a single image, faded by the alpha given.
+ *         Runs of solid pixels go through the vector blend kernels, anything
+ *         partially transparent is blended on its own.
+ */
+
+void SpriteSheet::blend( blit::Point p_dest, uint8_t p_alpha )
+{
+  /* Without a native copy, let the screen do the work. */
+  if ( ( nullptr == c_pixels ) || ( blit::PixelFormat::RGB != blit::screen.format ) )
+  {
+    uint8_t l_previous_alpha = blit::screen.alpha;
+    blit::screen.alpha = p_alpha;
+    blit::screen.blit( c_surface, c_surface->clip, p_dest );
+    blit::screen.alpha = l_previous_alpha;
+    return;
+  }
+
+  /* Clip what we're drawing against the screen. */
+  const blit::Rect &l_clip = blit::screen.clip;
+  int32_t l_left = std::max( p_dest.x, l_clip.x );
+  int32_t l_top = std::max( p_dest.y, l_clip.y );
+  int32_t l_right = std::min( p_dest.x + c_surface->bounds.w, l_clip.x + l_clip.w );
+  int32_t l_bottom = std::min( p_dest.y + c_surface->bounds.h, l_clip.y + l_clip.h );
+
+  /* Work through each line, a run at a time. */
+  for ( int32_t y = l_top; y < l_bottom; y++ )
+  {
+    uint32_t l_src = ( ( y - p_dest.y ) * c_surface->bounds.w ) + ( l_left - p_dest.x );
+    uint8_t *l_dst = blit::screen.data + ( ( y * blit::screen.bounds.w ) + l_left ) * 3;
+    int32_t  x = l_left;
+
+    while ( x < l_right )
+    {
+      /* Count how many pixels share this alpha. */
+      uint8_t l_alpha = c_alpha[l_src];
+      int32_t l_run = 1;
+      if ( ( 0 == l_alpha ) || ( 255 == l_alpha ) )
+      {
+        while ( ( ( x + l_run ) < l_right ) && ( l_alpha == c_alpha[l_src + l_run] ) )
+        {
+          l_run++;
+        }
+      }
+
+      /* Solid runs get blended in one go; partial pixels on their own. */
+      if ( 255 == l_alpha )
+      {
+        blend_span( l_dst, c_pixels + ( l_src * 3 ), l_run * 3, p_alpha );
+      }
+      else if ( 0 != l_alpha )
+      {
+        blend_span_scalar( l_dst, c_pixels + ( l_src * 3 ), 3, ( l_alpha * p_alpha ) / 255 );
+      }
+
+      /* And move along. */
+      x += l_run;
+      l_src += l_run;
+      l_dst += l_run * 3;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file SpriteSheet.cpp */
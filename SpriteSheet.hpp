@@ -0,0 +1,53 @@
+/*
+ * SpriteSheet.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The SpriteSheet class wraps up a loaded spritesheet; if native sheets are
+ * enabled, it converts the sheet once into the screen's own pixel format so
+ * that unscaled, opaque drawing becomes a straight copy rather than paying
+ * for a format conversion on every pixel.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _SPRITESHEET_HPP_
+#define   _SPRITESHEET_HPP_
+
+#include "32blit.hpp"
+
+#define SHEET_TILE_SIZE     8
+#define SHEET_TILE_MAX      256
+
+/* Native sheets are stored as RGB (3 bytes), plus one byte of alpha. */
+#define SHEET_NATIVE_BYTES(w,h) ( (w) * (h) * 4 )
+
+typedef enum
+{
+  SHEET_TRANSPARENT,
+  SHEET_OPAQUE,
+  SHEET_MIXED
+} sheetfill_t;
+
+class SpriteSheet
+{
+  private:
+    blit::Surface  *c_surface;
+    uint8_t        *c_pixels;
+    uint8_t        *c_alpha;
+    uint8_t         c_fill[SHEET_TILE_MAX];
+
+    bool            native( void );
+    void            copy( blit::Rect, blit::Point );
+
+  public:
+                    SpriteSheet( blit::Surface * );
+    blit::Surface  *surface( void );
+    void            tile( uint8_t, blit::Point );
+    void            sprite( blit::Rect, blit::Point );
+    void            blend( blit::Point, uint8_t );
+};
+
+#endif /* _SPRITESHEET_HPP_ */
+
+/* End of file SpriteSheet.hpp */
@@ -0,0 +1,247 @@
+/*
+ * ThumbCache.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The ThumbCache holds small thumbnail images of levels from a level pack,
+ * for the level selector. Thumbnails are only drawn when they're first asked
+ * for, and there are only ever a fixed number of them; when we need room the
+ * one that was used longest ago is recycled.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstring>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Arena.hpp"
+#include "ThumbCache.hpp"
+
+
+/* Functions. */
+
+/*
+ * ThumbCache - constructor; carves the thumbnail surfaces out of the arena,
+ *              all empty to start with.
+ */
+
+ThumbCache::ThumbCache( LevelPack *p_pack )
+{
+  /* Remember where the levels come from. */
+  c_pack = p_pack;
+
+  /* Set up a palette that looks a bit like the real thing. */
+  c_palette[THUMB_OUTSIDE] = blit::Pen( 0, 0, 0, 0 );
+  c_palette[THUMB_WALL] = blit::Pen( 120, 80, 60 );
+  c_palette[THUMB_FLOOR] = blit::Pen( 40, 40, 50 );
+  c_palette[THUMB_GOAL] = blit::Pen( 250, 128, 200 );
+  c_palette[THUMB_CRATE] = blit::Pen( 230, 180, 60 );
+  c_palette[THUMB_PLAYER] = blit::Pen( 154, 235, 0 );
+
+  /* And the surfaces, all sharing that palette. */
+  for ( uint8_t l_slot = 0; l_slot < THUMB_SLOTS; l_slot++ )
+  {
+    uint8_t *l_pixels = (uint8_t *)g_arena.alloc( THUMB_W * THUMB_H, ARENA_SPRITES );
+    void    *l_surface = g_arena.alloc( sizeof( blit::Surface ), ARENA_SPRITES );
+
+    c_surfaces[l_slot] = nullptr;
+    if ( ( nullptr != l_pixels ) && ( nullptr != l_surface ) )
+    {
+      c_surfaces[l_slot] = new( l_surface ) blit::Surface( l_pixels, blit::PixelFormat::P,
+                                                            blit::Size( THUMB_W, THUMB_H ) );
+      c_surfaces[l_slot]->palette = c_palette;
+    }
+    c_slots[l_slot].valid = false;
+    c_slots[l_slot].used = 0;
+    c_slots[l_slot].level = 0;
+  }
+
+  /* Nothing used yet, and nothing has failed. */
+  memset( c_failed, 0, sizeof( c_failed ) );
+  c_clock = 0;
+  c_generated = 0;
+  c_budget = THUMB_PER_FRAME;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * ~ThumbCache - destructor; the surfaces live in the arena, so they're only
+ *               destructed.
+ */
+
+ThumbCache::~ThumbCache( void )
+{
+  for ( uint8_t l_slot = 0; l_slot < THUMB_SLOTS; l_slot++ )
+  {
+    if ( nullptr != c_surfaces[l_slot] )
+    {
+      c_surfaces[l_slot]->~Surface();
+      c_surfaces[l_slot] = nullptr;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * frame - called at the start of each frame; we only draw a few thumbnails
+ *         each frame, so that paging through a pack never costs us a frame.
+ */
+
+void ThumbCache::frame( void )
+{
+  /* Reset the budget. */
+  c_budget = THUMB_PER_FRAME;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * generated - returns how many thumbnails we've drawn (or failed to) so far;
+ *             if this moves on, whatever shows them has something new to
+ *             show.
+ */
+
+uint32_t ThumbCache::generated( void )
+{
+  /* Simple access method. */
+  return c_generated;
+}
+
+
+/*
+ * draw - renders a decoded level into the surface in the given slot, with
+ *        each cell a small block of colour.
+ */
+
+void ThumbCache::draw( uint8_t p_slot, const packlevel_t &p_packlevel )
+{
+  blit::Surface *l_surface = c_surfaces[p_slot];
+  uint8_t        l_colour;
+
+  /* Start from nothing, and centre the level in the thumbnail. */
+  memset( l_surface->data, THUMB_OUTSIDE, THUMB_W * THUMB_H );
+  uint8_t l_left = ( LEVELPACK_MAX_W - p_packlevel.width ) / 2;
+  uint8_t l_top = ( LEVELPACK_MAX_H - p_packlevel.height ) / 2;
+
+  for ( uint8_t y = 0; y < p_packlevel.height; y++ )
+  {
+    /* Anything left of the first wall on a row is outside. */
+    bool l_inside = false;
+    for ( uint8_t x = 0; x < p_packlevel.width; x++ )
+    {
+      switch( p_packlevel.cells[y][x] )
+      {
+        case '#':
+          l_colour = THUMB_WALL;
+          l_inside = true;
+          break;
+        case '.':
+        case '+':
+          l_colour = THUMB_GOAL;
+          break;
+        case '$':
+        case '*':
+          l_colour = THUMB_CRATE;
+          break;
+        case '@':
+          l_colour = THUMB_PLAYER;
+          break;
+        default:
+          l_colour = l_inside ? THUMB_FLOOR : THUMB_OUTSIDE;
+          break;
+      }
+
+      /* Fill in the block for this cell. */
+      for ( uint8_t l_py = 0; l_py < THUMB_CELL; l_py++ )
+      {
+        memset( l_surface->data + ( ( l_top + y ) * THUMB_CELL + l_py ) * THUMB_W + ( l_left + x ) * THUMB_CELL,
+                l_colour, THUMB_CELL );
+      }
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * get - returns the thumbnail for the given pack level, drawing it if we
+ *       don't already have it. If we've already drawn enough this frame,
+ *       returns nullptr; ask again next frame. Levels that can't be drawn
+ *       at all are remembered, and always return nullptr.
+ */
+
+blit::Surface *ThumbCache::get( uint16_t p_level )
+{
+  uint8_t l_oldest = 0;
+
+  /* Look to see if we already have it, keeping an eye out for the slot */
+  /* that has gone unused for longest in case we don't.                  */
+  for ( uint8_t l_slot = 0; l_slot < THUMB_SLOTS; l_slot++ )
+  {
+    if ( c_slots[l_slot].valid && ( c_slots[l_slot].level == p_level ) )
+    {
+      c_slots[l_slot].used = ++c_clock;
+      return c_surfaces[l_slot];
+    }
+    if ( !c_slots[l_slot].valid ||
+         ( c_slots[l_oldest].valid && ( c_slots[l_slot].used < c_slots[l_oldest].used ) ) )
+    {
+      l_oldest = l_slot;
+    }
+  }
+
+  /* No point trying again with a level that we already know is no good; */
+  /* it was already counted as generated the first time it failed.        */
+  if ( ( p_level >= LEVELPACK_MAX_LEVELS ) ||
+       ( c_failed[p_level / 8] & ( 1 << ( p_level % 8 ) ) ) )
+  {
+    return nullptr;
+  }
+
+  /* Not there, so we need to draw it - if we can afford to. */
+  if ( ( 0 == c_budget ) || ( nullptr == c_surfaces[l_oldest] ) || ( nullptr == c_pack ) )
+  {
+    return nullptr;
+  }
+  c_budget--;
+
+  /* Decode the level; if that fails, whatever is in the slot stays put, */
+  /* and the failure counts as something new to show.                    */
+  packlevel_t l_packlevel;
+  if ( !c_pack->decode( p_level, l_packlevel ) )
+  {
+    c_failed[p_level / 8] |= ( 1 << ( p_level % 8 ) );
+    c_generated++;
+    return nullptr;
+  }
+
+  /* Otherwise, draw it into the slot we're recycling. */
+  draw( l_oldest, l_packlevel );
+  c_slots[l_oldest].level = p_level;
+  c_slots[l_oldest].used = ++c_clock;
+  c_slots[l_oldest].valid = true;
+  c_generated++;
+
+  /* All done. */
+  return c_surfaces[l_oldest];
+}
+
+
+/* End of file ThumbCache.cpp */
@@ -0,0 +1,70 @@
+/*
+ * ThumbCache.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The ThumbCache holds small thumbnail images of levels from a level pack,
+ * for the level selector. Thumbnails are only drawn when they're first asked
+ * for, and there are only ever a fixed number of them; when we need room the
+ * one that was used longest ago is recycled.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _THUMBCACHE_HPP_
+#define   _THUMBCACHE_HPP_
+
+#include "32blit.hpp"
+#include "LevelPack.hpp"
+
+#define THUMB_CELL          2       /* pixels per level cell */
+#define THUMB_W             ( LEVELPACK_MAX_W * THUMB_CELL )
+#define THUMB_H             ( LEVELPACK_MAX_H * THUMB_CELL )
+#define THUMB_SLOTS         16
+#define THUMB_PER_FRAME     2       /* most thumbnails we'll draw in a frame */
+
+/* Thumbnails are paletted, one byte per pixel. */
+
+typedef enum
+{
+  THUMB_OUTSIDE,
+  THUMB_WALL,
+  THUMB_FLOOR,
+  THUMB_GOAL,
+  THUMB_CRATE,
+  THUMB_PLAYER,
+  THUMB_COLOURS
+} thumbcolour_t;
+
+typedef struct
+{
+  uint16_t        level;
+  uint32_t        used;
+  bool            valid;
+} thumbslot_t;
+
+class ThumbCache
+{
+  private:
+    LevelPack      *c_pack;
+    blit::Pen       c_palette[THUMB_COLOURS];
+    blit::Surface  *c_surfaces[THUMB_SLOTS];
+    thumbslot_t     c_slots[THUMB_SLOTS];
+    uint8_t         c_failed[LEVELPACK_MAX_LEVELS / 8];   /* one bit per level */
+    uint32_t        c_clock;
+    uint32_t        c_generated;
+    uint8_t         c_budget;
+
+    void            draw( uint8_t, const packlevel_t & );
+
+  public:
+                    ThumbCache( LevelPack * );
+                   ~ThumbCache( void );
+    void            frame( void );
+    uint32_t        generated( void );
+    blit::Surface  *get( uint16_t );
+};
+
+#endif /* _THUMBCACHE_HPP_ */
+
+/* End of file ThumbCache.hpp */
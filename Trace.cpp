@@ -0,0 +1,230 @@
+/*
+ * Trace.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Event tracing; when built with SOKOBLIT_TRACE, the interesting parts of
+ * each frame record when they begin and end into a ring buffer, timed with
+ * the cycle counter on device. On Linux the buffer is written out as a Chrome
+ * trace file when we exit, so that a hitch can be picked apart afterwards.
+ * Without the flag, the macros compile away to nothing.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#ifdef SOKOBLIT_TRACE
+
+#include <cstdio>
+#include <cstdlib>
+
+#ifndef TARGET_32BLIT_HW
+#include <chrono>
+#endif /* TARGET_32BLIT_HW */
+
+#endif /* SOKOBLIT_TRACE */
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Trace.hpp"
+
+
+#ifdef SOKOBLIT_TRACE
+
+/* Module variables. */
+
+Trace g_trace;
+
+/* The Cortex-M7 cycle counter lives in the DWT unit, which has to be */
+/* switched on through the debug registers before it counts.          */
+
+#ifdef TARGET_32BLIT_HW
+#define TRACE_DEMCR         ( *(volatile uint32_t *)0xE000EDFC )
+#define TRACE_DWT_CTRL      ( *(volatile uint32_t *)0xE0001000 )
+#define TRACE_DWT_CYCCNT    ( *(volatile uint32_t *)0xE0001004 )
+#endif /* TARGET_32BLIT_HW */
+
+
+/* Functions. */
+
+/*
+ * trace_ticks - reads the clock we timestamp events with; this is expected
+ *               to wrap, so only differences between ticks mean anything.
+ */
+
+static inline uint32_t trace_ticks( void )
+{
+#ifdef TARGET_32BLIT_HW
+  return TRACE_DWT_CYCCNT;
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif /* TARGET_32BLIT_HW */
+}
+
+
+/*
+ * trace_exit - writes out whatever we've recorded, when the game exits.
+ */
+
+static void trace_exit( void )
+{
+  g_trace.dump( TRACE_FILE );
+  return;
+}
+
+
+/*
+ * Trace - constructor; the buffer starts empty.
+ */
+
+Trace::Trace( void )
+{
+  c_next = 0;
+  c_wrapped = false;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * start - gets the clock running; on the host, we also arrange for the trace
+ *         to be written out when we exit.
+ */
+
+void Trace::start( void )
+{
+#ifdef TARGET_32BLIT_HW
+  TRACE_DEMCR |= ( 1 << 24 );
+  TRACE_DWT_CYCCNT = 0;
+  TRACE_DWT_CTRL |= 1;
+#else
+  atexit( trace_exit );
+#endif /* TARGET_32BLIT_HW */
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * record - adds an event to the buffer; once it's full, we just overwrite
+ *          the oldest ones, so it's always the latest frames we have.
+ */
+
+void Trace::record( const char *p_name, tracephase_t p_phase )
+{
+  traceevent_t *l_event = &c_events[c_next];
+
+  l_event->name = p_name;
+  l_event->phase = p_phase;
+  l_event->ticks = trace_ticks();
+
+  if ( ++c_next >= TRACE_MAX )
+  {
+    c_next = 0;
+    c_wrapped = true;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * dump - writes the buffer out in Chrome's trace event format, oldest event
+ *        first. The ticks are unwrapped as we go, and any ends which lost
+ *        their beginning when the buffer wrapped are dropped. Only the host
+ *        has anywhere to write this.
+ */
+
+bool Trace::dump( const char *p_path )
+{
+#ifdef TARGET_32BLIT_HW
+  return false;
+#else
+  FILE     *l_file = fopen( p_path, "w" );
+  uint32_t  l_first = c_wrapped ? c_next : 0;
+  uint32_t  l_count = c_wrapped ? TRACE_MAX : c_next;
+  uint32_t  l_previous = c_events[l_first].ticks;
+  uint64_t  l_elapsed = 0;
+  uint32_t  l_depth = 0;
+  bool      l_comma = false;
+
+  if ( nullptr == l_file )
+  {
+    return false;
+  }
+
+  fprintf( l_file, "{\"traceEvents\":[\n" );
+  for ( uint32_t l_index = 0; l_index < l_count; l_index++ )
+  {
+    traceevent_t *l_event = &c_events[( l_first + l_index ) % TRACE_MAX];
+
+    l_elapsed += (uint32_t)( l_event->ticks - l_previous );
+    l_previous = l_event->ticks;
+
+    if ( TRACEPHASE_BEGIN == l_event->phase )
+    {
+      l_depth++;
+    }
+    else if ( 0 == l_depth )
+    {
+      continue;
+    }
+    else
+    {
+      l_depth--;
+    }
+
+    fprintf( l_file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":1,\"tid\":1}",
+             l_comma ? ",\n" : "", l_event->name, ( TRACEPHASE_BEGIN == l_event->phase ) ? 'B' : 'E',
+             (unsigned long long)( l_elapsed / TRACE_TICKS_PER_US ),
+             (unsigned)( ( l_elapsed % TRACE_TICKS_PER_US ) * 1000 / TRACE_TICKS_PER_US ) );
+    l_comma = true;
+  }
+  fprintf( l_file, "\n]}\n" );
+  fclose( l_file );
+
+  blit::debugf( "Trace: %lu events written to %s\n", (unsigned long)l_count, p_path );
+  return true;
+#endif /* TARGET_32BLIT_HW */
+}
+
+
+/*
+ * TraceScope - constructor, which records the beginning of the event.
+ */
+
+TraceScope::TraceScope( const char *p_name )
+{
+  c_name = p_name;
+  g_trace.record( c_name, TRACEPHASE_BEGIN );
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * ~TraceScope - destructor, which records the end of it.
+ */
+
+TraceScope::~TraceScope( void )
+{
+  g_trace.record( c_name, TRACEPHASE_END );
+
+  /* All done. */
+  return;
+}
+
+#endif /* SOKOBLIT_TRACE */
+
+
+/* End of file Trace.cpp */
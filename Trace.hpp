@@ -0,0 +1,88 @@
+/*
+ * Trace.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Event tracing; when built with SOKOBLIT_TRACE, the interesting parts of
+ * each frame record when they begin and end into a ring buffer, timed with
+ * the cycle counter on device. On Linux the buffer is written out as a Chrome
+ * trace file when we exit, so that a hitch can be picked apart afterwards.
+ * Without the flag, the macros compile away to nothing.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _TRACE_HPP_
+#define   _TRACE_HPP_
+
+#include "32blit.hpp"
+
+#define TRACE_FILE          "sokoblit-trace.json"
+
+/* The device has a lot less room to spare than the host. */
+
+#ifdef TARGET_32BLIT_HW
+#define TRACE_MAX           1024
+#define TRACE_TICKS_PER_US  480     /* the core clock, in MHz */
+#else
+#define TRACE_MAX           16384
+#define TRACE_TICKS_PER_US  1000    /* a nanosecond clock */
+#endif /* TARGET_32BLIT_HW */
+
+typedef enum
+{
+  TRACEPHASE_BEGIN,
+  TRACEPHASE_END
+} tracephase_t;
+
+typedef struct
+{
+  const char     *name;
+  uint32_t        ticks;
+  tracephase_t    phase;
+} traceevent_t;
+
+class Trace
+{
+  private:
+    traceevent_t    c_events[TRACE_MAX];
+    uint32_t        c_next;
+    bool            c_wrapped;
+
+  public:
+                    Trace( void );
+    void            start( void );
+    void            record( const char *, tracephase_t );
+    bool            dump( const char * );
+};
+
+/* Records the end of a trace event when it goes out of scope, however the */
+/* function it's in returns.                                              */
+
+class TraceScope
+{
+  private:
+    const char     *c_name;
+
+  public:
+                    TraceScope( const char * );
+                   ~TraceScope( void );
+};
+
+extern Trace g_trace;
+
+#ifdef SOKOBLIT_TRACE
+#define TRACE_START()       g_trace.start()
+#define TRACE_SCOPE(n)      TraceScope l_trace_scope( n )
+#define TRACE_BEGIN(n)      g_trace.record( n, TRACEPHASE_BEGIN )
+#define TRACE_END(n)        g_trace.record( n, TRACEPHASE_END )
+#else
+#define TRACE_START()       do {} while( 0 )
+#define TRACE_SCOPE(n)      do {} while( 0 )
+#define TRACE_BEGIN(n)      do {} while( 0 )
+#define TRACE_END(n)        do {} while( 0 )
+#endif /* SOKOBLIT_TRACE */
+
+#endif /* _TRACE_HPP_ */
+
+/* End of file Trace.hpp */
@@ -0,0 +1,194 @@
+/*
+ * Tween.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The Tweener runs all our animations; each tween moves a value from where
+ * it is to where it's going over a set time, with a choice of easing. It is
+ * driven from the clock rather than counting ticks, and only the tweens that
+ * are actually running cost anything to update.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <cstring>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "sokoblit.hpp"
+
+#include "Tween.hpp"
+
+
+/* Module variables. */
+
+Tweener g_tweener;
+
+
+/* Functions. */
+
+/*
+ * Tweener - constructor, which starts with nothing running.
+ */
+
+Tweener::Tweener( void )
+{
+  memset( c_tweens, 0, sizeof( c_tweens ) );
+  c_active = 0;
+  c_now = 0;
+
+  /* All done! */
+  return;
+}
+
+
+/*
+ * find - looks for a running tween on the given target; returns its index,
+ *        or -1 if there isn't one.
+ */
+
+int8_t Tweener::find( uint8_t *p_target )
+{
+  for ( uint8_t l_index = 0; l_index < c_active; l_index++ )
+  {
+    if ( c_tweens[l_index].target == p_target )
+    {
+      return l_index;
+    }
+  }
+
+  /* Not found. */
+  return -1;
+}
+
+
+/*
+ * retire - removes a tween from the running set; the last running one is
+ *          moved into its place, so the running tweens are always packed
+ *          at the front.
+ */
+
+void Tweener::retire( uint8_t p_index )
+{
+  c_active--;
+  c_tweens[p_index] = c_tweens[c_active];
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * start - sets a value moving from where it is now to the value given, over
+ *         the duration (in milliseconds) given. Any tween already running on
+ *         that value is replaced. If we've no room left, the value simply
+ *         jumps straight to its destination and we return false.
+ */
+
+bool Tweener::start( uint8_t *p_target, uint8_t p_to, uint32_t p_duration, ease_t p_ease )
+{
+  int8_t l_index = find( p_target );
+
+  /* If it's not already moving, we need a new slot. */
+  if ( l_index < 0 )
+  {
+    if ( c_active >= TWEEN_MAX )
+    {
+      *p_target = p_to;
+      return false;
+    }
+    l_index = c_active++;
+  }
+
+  /* Fill in the details; it starts from right now. */
+  c_tweens[l_index].target = p_target;
+  c_tweens[l_index].from = *p_target;
+  c_tweens[l_index].to = p_to;
+  c_tweens[l_index].ease = p_ease;
+  c_tweens[l_index].start = c_now;
+  c_tweens[l_index].duration = p_duration;
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * cancel - stops any tween running on the given target, leaving the value
+ *          wherever it has got to.
+ */
+
+void Tweener::cancel( uint8_t *p_target )
+{
+  int8_t l_index = find( p_target );
+
+  if ( l_index >= 0 )
+  {
+    retire( l_index );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * active - returns true if the given target is still being tweened.
+ */
+
+bool Tweener::active( uint8_t *p_target )
+{
+  return find( p_target ) >= 0;
+}
+
+
+/*
+ * update - moves all the running tweens on to where they should be at the
+ *          time given; any which have arrived are retired.
+ */
+
+void Tweener::update( uint32_t p_time )
+{
+  uint8_t l_index = 0;
+
+  /* Remember the time, so that new tweens start from it. */
+  c_now = p_time;
+
+  while ( l_index < c_active )
+  {
+    tween_t *l_tween = &c_tweens[l_index];
+    uint32_t l_elapsed = p_time - l_tween->start;
+
+    /* If it's arrived, put it there and forget about it. */
+    if ( l_elapsed >= l_tween->duration )
+    {
+      *l_tween->target = l_tween->to;
+      retire( l_index );
+      continue;
+    }
+
+    /* Otherwise, work out how far along it is, and ease that. */
+    fixed_t l_progress = (fixed_t)( ( (uint64_t)l_elapsed << FIXED_SHIFT ) / l_tween->duration );
+    if ( EASE_IN_OUT == l_tween->ease )
+    {
+      /* Smoothstep; 3p^2 - 2p^3. */
+      l_progress = fixed_mul( fixed_mul( l_progress, l_progress ), FIXED_INT( 3 ) - 2 * l_progress );
+    }
+    /* Rounding towards the start means we only arrive right at the end. */
+    *l_tween->target = l_tween->from +
+                       ( ( l_tween->to - l_tween->from ) * l_progress ) / FIXED_ONE;
+
+    /* On to the next one. */
+    l_index++;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file Tween.cpp */
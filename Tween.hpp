@@ -0,0 +1,60 @@
+/*
+ * Tween.hpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * The Tweener runs all our animations; each tween moves a value from where
+ * it is to where it's going over a set time, with a choice of easing. It is
+ * driven from the clock rather than counting ticks, and only the tweens that
+ * are actually running cost anything to update.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+#ifndef   _TWEEN_HPP_
+#define   _TWEEN_HPP_
+
+#include "32blit.hpp"
+#include "Geometry.hpp"
+
+#define TWEEN_MAX           8
+
+typedef enum
+{
+  EASE_LINEAR,
+  EASE_IN_OUT
+} ease_t;
+
+typedef struct
+{
+  uint8_t  *target;
+  uint8_t   from;
+  uint8_t   to;
+  ease_t    ease;
+  uint32_t  start;
+  uint32_t  duration;
+} tween_t;
+
+class Tweener
+{
+  private:
+    tween_t         c_tweens[TWEEN_MAX];
+    uint8_t         c_active;
+    uint32_t        c_now;
+
+    int8_t          find( uint8_t * );
+    void            retire( uint8_t );
+
+  public:
+                    Tweener( void );
+    bool            start( uint8_t *, uint8_t, uint32_t, ease_t );
+    void            cancel( uint8_t * );
+    bool            active( uint8_t * );
+    void            update( uint32_t );
+};
+
+extern Tweener g_tweener;
+
+#endif /* _TWEEN_HPP_ */
+
+/* End of file Tween.hpp */
@@ -13,14 +13,26 @@
 
 /* System headers. */
 
+#include <cstdlib>
+#include <cstring>
 
 /* Local headers. */
 
 #include "32blit.hpp"
 #include "sokoblit.hpp"
 
+#include "AllocCount.hpp"
+#include "Arena.hpp"
+#include "AssetPack.hpp"
+#include "Attract.hpp"
+#include "Blend.hpp"
+#include "Capture.hpp"
 #include "Game.hpp"
+#include "Geometry.hpp"
+#include "Governor.hpp"
 #include "Menu.hpp"
+#include "Trace.hpp"
+#include "Tween.hpp"
 
 
 /* Global variables (yes, I know...) */
@@ -30,58 +42,67 @@ Menu     *g_menu = nullptr;
 uimode_t  g_mode = MODE_MENU;
 uint8_t   g_level = 1;
 uint8_t   g_zoom = 100;
+bool      g_lores = false;
+bool      g_drawn = false;
+uint32_t  g_drawn_state[7];
+#ifdef SOKOBLIT_LORES_TRANSITIONS
+bool      g_lores_transitions = true;
+#else
+bool      g_lores_transitions = false;
+#endif /* SOKOBLIT_LORES_TRANSITIONS */
 
 
 /* Functions. */
 
 /*
- * level_centre - works out the centre of a level, in world co-ordinates. Done
- *                here so everything has a common view about it!
+ * render_scale - how many world pixels each screen pixel covers; normally one,
+ *                but two if we've dropped down to lores.
  */
 
-blit::Point level_centre( uint8_t p_level )
+uint8_t render_scale( void )
 {
-  blit::Point l_point = blit::Point( 0, 0 );
+  return SOKOBLIT_WORLD_W / blit::screen.bounds.w;
+}
 
-  /* The first 10 levels are pretty easy. */
-  if ( p_level >= 1 && p_level <= 5 )
-  {
-    l_point.x = ( blit::screen.bounds.w * p_level ) - ( blit::screen.bounds.w / 2 );
-    l_point.y = blit::screen.bounds.h * 0.5;
-  }
-  if ( p_level >= 6 && p_level <= 10 )
-  {
-    l_point.x = ( blit::screen.bounds.w * ( p_level - 5 ) ) - ( blit::screen.bounds.w / 2 );
-    l_point.y = blit::screen.bounds.h * 1.5;
-  }
 
-  /* And the last 10, too */
-  if ( p_level >= 13 && p_level <= 17 )
-  {
-    l_point.x = ( blit::screen.bounds.w * ( p_level - 12 ) ) - ( blit::screen.bounds.w / 2 );
-    l_point.y = blit::screen.bounds.h * 3.5;
-  }
-  if ( p_level >= 18 && p_level <= 22 )
-  {
-    l_point.x = ( blit::screen.bounds.w * ( p_level - 17 ) ) - ( blit::screen.bounds.w / 2 );
-    l_point.y = blit::screen.bounds.h * 4.5;
-  }
+/*
+ * set_resolution - picks the screen mode we should be in; if lores transitions
+ *                  are enabled we drop to lores while zooming between the menu
+ *                  and the game, and only go back to hires once we've arrived.
+ */
 
-  /* The side middle two.... we'll just hard code. */
-  if ( 11 == p_level )
-  {
-    l_point.x = blit::screen.bounds.w * 0.5;
-    l_point.y = blit::screen.bounds.h * 2.5;
-  }
+void set_resolution( void )
+{
+  bool l_lores = g_lores_transitions &&
+                 ( ( MODE_TO_GAME == g_mode ) || ( MODE_TO_MENU == g_mode ) );
 
-  if ( 12 == p_level )
+  /* Only switch if we need to. */
+  if ( l_lores != g_lores )
   {
-    l_point.x = blit::screen.bounds.w * 4.5;
-    l_point.y = blit::screen.bounds.h * 2.5;
+    blit::set_screen_mode( l_lores ? blit::ScreenMode::lores : blit::ScreenMode::hires );
+    g_lores = l_lores;
   }
 
-  /* And return what we worked out. */
-  return l_point;
+  /* All done. */
+  return;
+}
+
+
+/*
+ * log_phase - reports how long a phase of startup took, given the time (in
+ *             microseconds) that it started. Only the host builds have anywhere
+ *             sensible to write this to.
+ */
+
+void log_phase( const char *p_phase, uint32_t p_start )
+{
+#ifndef TARGET_32BLIT_HW
+  blit::debugf( "init: %-14s %6lu us\n", p_phase,
+                (unsigned long)blit::us_diff( p_start, blit::now_us() ) );
+#endif /* TARGET_32BLIT_HW */
+
+  /* All done. */
+  return;
 }
 
 
@@ -92,25 +113,66 @@ blit::Point level_centre( uint8_t p_level )
 
 void init( void )
 {
+  uint32_t l_start = blit::now_us();
+
+  /* Get the trace clock running, if we're tracing. */
+  TRACE_START();
+
   /* Switch into hires mode, please. */
   blit::set_screen_mode( blit::ScreenMode::hires );
+  log_phase( "screen mode", l_start );
+
+  /* The geometry tables are needed by everything else. */
+  geometry_init();
 
-  /* Create the menu and game objects that handle everything. */
-  g_menu = new Menu();
-  g_game = new Game();
+  /* If we've been asked for benchmarks, run them before anything else. */
+  blend_benchmark();
+  geometry_benchmark();
+
+  /* On the host, assets can come from an external pack instead of the */
+  /* ones built in; there's no harm at all in there not being one.      */
+  g_assets.open( ( nullptr != getenv( ASSETPACK_ENV ) ) ? getenv( ASSETPACK_ENV ) : ASSETPACK_FILE );
+  log_phase( "asset pack", l_start );
+
+  /* Create the menu and game objects that handle everything; these live */
+  /* in the arena, rather than on the heap.                              */
+  void *l_menu = g_arena.alloc( sizeof( Menu ), ARENA_CORE );
+  void *l_game = g_arena.alloc( sizeof( Game ), ARENA_CORE );
+  if ( ( nullptr == l_menu ) || ( nullptr == l_game ) )
+  {
+    /* Without both of them, there is nothing we can do. */
+    blit::debugf( "Init failed: out of arena for the menu and game\n" );
+    return;
+  }
+  g_menu = new( l_menu ) Menu();
+  g_game = new( l_game ) Game();
+
+#if !defined( SOKOBLIT_DEFERRED_LOAD ) || defined( SOKOBLIT_CAPTURE )
+  /* Load the whole game now, before we show anything. */
+  while( !g_game->load() );
+  g_menu->set_game( g_game );
+  g_menu->set_pack( g_game->pack() );
+  log_phase( "total", l_start );
+
+  /* Let the world know how much memory that all took. */
+  g_arena.report();
+#endif /* SOKOBLIT_DEFERRED_LOAD */
+
+  /* If we're only here to capture reference frames, that happens now. */
+  capture_run();
 }
 
 
 /*
- * render - called every frame to draw the world view
+ * render_frame - draws the world view, within the screen's current clip.
  */
 
-void render( uint32_t p_time )
+void render_frame( uint32_t p_time )
 {
   /* Clear the screen down, so that whichever render does the work gets */
   /* a clean slate to work from.                                        */
   blit::screen.pen = blit::Pen( 0, 0, 0 );
-  blit::screen.clear();
+  blit::screen.rectangle( blit::screen.clip );
 
   /* Work out which tilemap(s) we should render, and render them. */
   if ( MODE_GAME != g_mode )
@@ -120,9 +182,13 @@ void render( uint32_t p_time )
         g_menu->render( p_time, g_zoom );
     }
   }
-  if ( nullptr != g_game )
+  if ( ( nullptr != g_menu ) && ( g_menu->browsing() ) )
+  {
+    /* The pack browser covers everything, so the game can stay hidden. */
+  }
+  else if ( ( nullptr != g_game ) && ( g_game->ready() ) )
   {
-      g_game->render( p_time, g_zoom );
+      g_game->render( p_time, g_zoom, g_menu );
   }
 
   /* All done */
@@ -131,45 +197,118 @@ void render( uint32_t p_time )
 
 
 /*
- * update - called every 10ms to update the world view.
+ * render - called every frame to draw the world view; if nothing we draw has
+ *          changed since the last frame, we leave the screen alone.
  */
 
-void update( uint32_t p_time )
+void render( uint32_t p_time )
 {
-  /* If we're transitioning, update the progress. */
-  if ( MODE_TO_GAME == g_mode )
+  TRACE_SCOPE( "render" );
+  ALLOC_SCOPE( ALLOC_RENDER );
+  uint32_t   l_start = blit::now_us();
+  uint32_t   l_state[7];
+  blit::Rect l_pulse;
+
+  /* Gather up everything that affects what ends up on screen. */
+  l_state[0] = g_mode;
+  l_state[1] = g_zoom;
+  l_state[2] = g_level;
+  l_state[3] = render_scale();
+  l_state[4] = g_governor.tier();
+  l_state[5] = ( nullptr != g_game ) ? g_game->signature() : 0;
+  l_state[6] = ( nullptr != g_menu ) ? g_menu->signature() : 0;
+
+  /* If nothing has changed, the most we need to do is the pulsing level  */
+  /* rectangle in the menu - and then only the area it covers, in one go. */
+  if ( g_drawn && ( 0 == memcmp( l_state, g_drawn_state, sizeof( l_state ) ) ) )
   {
-    /* Decrease progress, and if we hit zero we've reached GAME. */
-    if ( 0 == --g_zoom )
+    if ( ( MODE_MENU == g_mode ) && ( nullptr != g_menu ) && ( g_menu->pulsing( &l_pulse ) ) )
     {
-      g_mode = MODE_GAME;
+      blit::Rect l_clip = blit::screen.clip;
+      blit::screen.clip = l_pulse.intersection( l_clip );
+      render_frame( p_time );
+      blit::screen.clip = l_clip;
     }
+    return;
   }
 
-  if ( MODE_TO_MENU == g_mode )
+  /* Otherwise, it's a full redraw. */
+  render_frame( p_time );
+  memcpy( g_drawn_state, l_state, sizeof( l_state ) );
+  g_drawn = true;
+
+  /* Let the governor know how long that took, so it can adjust quality. */
+  g_governor.record( blit::us_diff( l_start, blit::now_us() ) );
+
+  /* All done */
+  return;
+}
+
+
+/*
+ * update - called every 10ms to update the world view.
+ */
+
+void update( uint32_t p_time )
+{
+  TRACE_SCOPE( "update" );
+
+  /* Report on allocations before we start counting this call's. */
+  ALLOC_REPORT( p_time );
+  ALLOC_SCOPE( ALLOC_UPDATE );
+
+  /* If the game is still loading, do the next chunk of that; we can't go */
+  /* anywhere near it until it's done.                                    */
+  if ( ( nullptr != g_game ) && ( !g_game->ready() ) )
   {
-    /* Increase progress, and if we hit 100 we've reached MENU. */
-    if ( 100 == ++g_zoom )
+    if ( g_game->load() && g_game->ready() && ( nullptr != g_menu ) )
     {
-      g_mode = MODE_MENU;
+      g_menu->set_game( g_game );
+      g_menu->set_pack( g_game->pack() );
+      g_arena.report();
     }
   }
 
+  /* Move all the animations on to where they should be by now. */
+  g_tweener.update( p_time );
+
+  /* If we're transitioning, we've arrived once the zoom stops moving. */
+  if ( ( MODE_TO_GAME == g_mode ) && ( !g_tweener.active( &g_zoom ) ) )
+  {
+    g_mode = MODE_GAME;
+  }
+  if ( ( MODE_TO_MENU == g_mode ) && ( !g_tweener.active( &g_zoom ) ) )
+  {
+    g_mode = MODE_MENU;
+  }
+
+  /* The attract mode takes over if the menu is left alone for long enough; */
+  /* any input stops it again, and that input goes no further.             */
+  bool l_attract = ( nullptr != g_game ) && ( nullptr != g_menu ) &&
+                   g_attract.update( p_time, g_game, g_menu );
+
   /* Check the menu button, which is a universal toggle. */
-  if ( ( blit::buttons.pressed & blit::Button::MENU ) ||
-       ( blit::buttons.pressed & blit::Button::A ) )
+  if ( ( !l_attract ) &&
+       ( ( blit::buttons.pressed & blit::Button::MENU ) ||
+         ( blit::buttons.pressed & blit::Button::A ) ) )
   {
     /* Only acts if we're in a steady state. */
-    if ( MODE_MENU == g_mode )
+    if ( ( MODE_MENU == g_mode ) && ( nullptr != g_game ) && ( g_game->ready() ) &&
+         ( nullptr != g_menu ) && ( !g_menu->browsing() ) )
     {
       g_mode = MODE_TO_GAME;
+      g_tweener.start( &g_zoom, 0, SOKOBLIT_ZOOM_MS, EASE_IN_OUT );
     }
-    if ( MODE_GAME == g_mode )
+    else if ( MODE_GAME == g_mode )
     {
       g_mode = MODE_TO_MENU;
+      g_tweener.start( &g_zoom, 100, SOKOBLIT_ZOOM_MS, EASE_IN_OUT );
     }
   }
 
+  /* Make sure we're drawing at the right resolution for where we are. */
+  set_resolution();
+
   /* Only bother updating object that are active. */
   if ( MODE_GAME != g_mode )
   {
@@ -180,12 +319,19 @@ void update( uint32_t p_time )
   }
   if ( MODE_MENU != g_mode )
   {
-    if ( nullptr != g_game )
+    if ( ( nullptr != g_game ) && ( g_game->ready() ) )
     {
       g_game->update( p_time );
     }
   }
 
+  /* Let the menu catch up with anything that's changed in the game, so */
+  /* that the overview is right by the time it's next drawn.            */
+  if ( nullptr != g_menu )
+  {
+    g_menu->sync();
+  }
+
   /* All done. */
   return;
 }
@@ -13,17 +13,21 @@
 #define   _SOKOBLIT_HPP_
 
 #include "32blit.hpp"
+#include "Layout.hpp"
+#include "Rules.hpp"
 
-#define  SOKOBLIT_LEVEL_MAX   22
+/* The level count comes from the layout of the map. */
 
-/* Constants based on tiled tiles - tinker at your peril! */
+#define  SOKOBLIT_LEVEL_MAX   LAYOUT_LEVELS
 
-#define TILED_RESET       0
-#define TILED_WALL        2
-#define TILED_CRATE       4
-#define TILED_EMPTY       34
-#define TILED_CRATE_HOME  36
-#define TILED_PLAYER_HOME 76
+/* The world is laid out in hires screens, whatever mode we're drawing in. */
+
+#define  SOKOBLIT_WORLD_W     320
+#define  SOKOBLIT_WORLD_H     240
+
+/* How long it takes to zoom between the menu and the game. */
+
+#define  SOKOBLIT_ZOOM_MS     1000
 
 typedef enum 
 {
@@ -34,9 +38,15 @@ typedef enum
   MODE_MAX
 } uimode_t;
 
-extern uint8_t g_level;
+extern uimode_t g_mode;
+extern uint8_t  g_level;
+extern uint8_t  g_zoom;
+extern bool     g_lores_transitions;
 
-blit::Point level_centre( uint8_t );
+uint8_t     render_scale( void );
+void        render_frame( uint32_t );
+void        update( uint32_t );
+void        log_phase( const char *, uint32_t );
 
 
 #endif /* _SOKOBLIT_HPP_ */
@@ -0,0 +1,613 @@
+/*
+ * levelgen.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Host-only level generator. Each level is built backwards; we carve out a
+ * room, drop the crates onto their goals, and then play in reverse (pulling
+ * crates about) from that solved state. Whatever we end up with is, by
+ * construction, solvable - we then solve it forwards anyway, to score how
+ * hard it is from the solution length, the branching along the way and how
+ * much of the floor is deadly for a crate.
+ *
+ * Candidates are generated across all the cores we have, and the best are
+ * written out as a standard XSB level pack.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+
+/* Constants. */
+
+#define LEVELGEN_MAX_W        20      /* the biggest level the game can show */
+#define LEVELGEN_MAX_H        15
+#define LEVELGEN_MAX_CRATES   8
+#define LEVELGEN_SOLVE_LIMIT  200000  /* states, before we give up solving */
+
+static const int8_t g_dir_x[4] = { 0, -1, 0, 1 };
+static const int8_t g_dir_y[4] = { 1, 0, -1, 0 };
+
+
+/* Types. */
+
+typedef struct
+{
+  uint8_t                 width;
+  uint8_t                 height;
+  uint8_t                 crates;
+  uint32_t                count;
+  uint32_t                seed;
+  uint32_t                threads;
+  uint32_t                tries;
+  const char             *output;
+} options_t;
+
+typedef struct
+{
+  uint8_t                 width;
+  uint8_t                 height;
+  std::vector<uint8_t>    floor;      /* 1 for floor, 0 for wall */
+  std::vector<uint8_t>    goal;
+  std::vector<uint16_t>   crates;     /* cell indices, kept sorted */
+  uint16_t                player;
+} level_t;
+
+typedef struct
+{
+  level_t                 level;
+  uint32_t                pushes;
+  float                   branching;
+  float                   deadly;
+  float                   score;
+} candidate_t;
+
+
+/* Functions. */
+
+/*
+ * reachable - flood fills from the player's cell, around walls and crates,
+ *             marking every cell they can walk to.
+ */
+
+static void reachable( const level_t &p_level, const std::vector<uint16_t> &p_crates,
+                       uint16_t p_player, std::vector<uint8_t> &p_reach )
+{
+  std::vector<uint16_t> l_queue;
+  std::vector<uint8_t>  l_blocked( p_level.floor.size(), 0 );
+
+  for ( uint16_t l_crate : p_crates )
+  {
+    l_blocked[l_crate] = 1;
+  }
+
+  p_reach.assign( p_level.floor.size(), 0 );
+  p_reach[p_player] = 1;
+  l_queue.push_back( p_player );
+
+  for ( size_t l_head = 0; l_head < l_queue.size(); l_head++ )
+  {
+    uint16_t l_cell = l_queue[l_head];
+    for ( uint8_t l_dir = 0; l_dir < 4; l_dir++ )
+    {
+      uint16_t l_next = l_cell + g_dir_x[l_dir] + g_dir_y[l_dir] * p_level.width;
+      if ( p_level.floor[l_next] && !l_blocked[l_next] && !p_reach[l_next] )
+      {
+        p_reach[l_next] = 1;
+        l_queue.push_back( l_next );
+      }
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * carve - builds a random room; a few overlapping rectangles joined up with
+ *         a random walk, always leaving a wall all the way round the edge.
+ */
+
+static void carve( level_t &p_level, std::mt19937 &p_rng )
+{
+  uint8_t l_w = p_level.width, l_h = p_level.height;
+
+  p_level.floor.assign( l_w * l_h, 0 );
+  p_level.goal.assign( l_w * l_h, 0 );
+
+  /* Knock out some rectangles. */
+  uint8_t l_rooms = 2 + p_rng() % 4;
+  for ( uint8_t l_room = 0; l_room < l_rooms; l_room++ )
+  {
+    uint8_t l_rw = 2 + p_rng() % 3, l_rh = 2 + p_rng() % 3;
+    uint8_t l_rx = 1 + p_rng() % std::max( 1, l_w - 1 - l_rw );
+    uint8_t l_ry = 1 + p_rng() % std::max( 1, l_h - 1 - l_rh );
+    for ( uint8_t y = l_ry; ( y < l_ry + l_rh ) && ( y < l_h - 1 ); y++ )
+    {
+      for ( uint8_t x = l_rx; ( x < l_rx + l_rw ) && ( x < l_w - 1 ); x++ )
+      {
+        p_level.floor[x + y * l_w] = 1;
+      }
+    }
+  }
+
+  /* And wander about between them, so that they're joined up. */
+  int16_t l_x = 1 + p_rng() % ( l_w - 2 ), l_y = 1 + p_rng() % ( l_h - 2 );
+  for ( uint16_t l_step = 0; l_step < l_w * l_h; l_step++ )
+  {
+    p_level.floor[l_x + l_y * l_w] = 1;
+    uint8_t l_dir = p_rng() % 4;
+    l_x = std::min<int16_t>( std::max<int16_t>( l_x + g_dir_x[l_dir], 1 ), l_w - 2 );
+    l_y = std::min<int16_t>( std::max<int16_t>( l_y + g_dir_y[l_dir], 1 ), l_h - 2 );
+  }
+
+  /* Keep only the floor joined up to where the walk finished. */
+  std::vector<uint8_t> l_reach;
+  reachable( p_level, std::vector<uint16_t>(), l_x + l_y * l_w, l_reach );
+  p_level.floor = l_reach;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * live_cells - works out every cell from which a crate could (on its own)
+ *              still be pushed to a goal, by pulling crates out from each
+ *              goal in turn. Anything else is a dead square.
+ */
+
+static void live_cells( const level_t &p_level, std::vector<uint8_t> &p_live )
+{
+  std::vector<uint16_t> l_queue;
+
+  p_live.assign( p_level.floor.size(), 0 );
+  for ( uint16_t l_cell = 0; l_cell < p_level.floor.size(); l_cell++ )
+  {
+    if ( p_level.goal[l_cell] )
+    {
+      p_live[l_cell] = 1;
+      l_queue.push_back( l_cell );
+    }
+  }
+
+  for ( size_t l_head = 0; l_head < l_queue.size(); l_head++ )
+  {
+    uint16_t l_cell = l_queue[l_head];
+    for ( uint8_t l_dir = 0; l_dir < 4; l_dir++ )
+    {
+      int16_t  l_offset = g_dir_x[l_dir] + g_dir_y[l_dir] * p_level.width;
+      uint16_t l_next = l_cell + l_offset;
+      if ( p_level.floor[l_next] && p_level.floor[l_next + l_offset] && !p_live[l_next] )
+      {
+        p_live[l_next] = 1;
+        l_queue.push_back( l_next );
+      }
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * normalise - the player can be anywhere in the area they can reach, so for
+ *             comparing states we use the lowest cell in that area.
+ */
+
+static uint16_t normalise( const std::vector<uint8_t> &p_reach )
+{
+  for ( uint16_t l_cell = 0; l_cell < p_reach.size(); l_cell++ )
+  {
+    if ( p_reach[l_cell] )
+    {
+      return l_cell;
+    }
+  }
+  return 0;
+}
+
+
+/*
+ * solve - a breadth first search over pushes, to find the shortest solution
+ *         (in pushes). Also measures the average number of pushes available
+ *         from each state we look at. Returns false if we ran out of room.
+ */
+
+static bool solve( const level_t &p_level, const std::vector<uint8_t> &p_live,
+                   uint32_t &p_pushes, float &p_branching )
+{
+  std::vector<std::vector<uint16_t>>  l_states;
+  std::vector<uint32_t>               l_depth;
+  std::unordered_set<std::string>     l_seen;
+  std::vector<uint8_t>                l_reach;
+  uint64_t                            l_successors = 0;
+
+  /* Each state is the normalised player cell and then the crates. */
+  auto l_key = []( const std::vector<uint16_t> &p_state )
+  {
+    return std::string( (const char *)p_state.data(), p_state.size() * sizeof( uint16_t ) );
+  };
+
+  std::vector<uint16_t> l_start;
+  reachable( p_level, p_level.crates, p_level.player, l_reach );
+  l_start.push_back( normalise( l_reach ) );
+  l_start.insert( l_start.end(), p_level.crates.begin(), p_level.crates.end() );
+  l_states.push_back( l_start );
+  l_depth.push_back( 0 );
+  l_seen.insert( l_key( l_start ) );
+
+  for ( size_t l_head = 0; l_head < l_states.size(); l_head++ )
+  {
+    std::vector<uint16_t> l_state = l_states[l_head];
+    std::vector<uint16_t> l_crates( l_state.begin() + 1, l_state.end() );
+
+    /* Solved if every crate is on a goal. */
+    bool l_solved = true;
+    for ( uint16_t l_crate : l_crates )
+    {
+      l_solved = l_solved && p_level.goal[l_crate];
+    }
+    if ( l_solved )
+    {
+      p_pushes = l_depth[l_head];
+      p_branching = (float)l_successors / ( l_head ? l_head : 1 );
+      return true;
+    }
+
+    /* Otherwise, try every push the player can get to. */
+    reachable( p_level, l_crates, l_state[0], l_reach );
+    for ( size_t l_index = 0; l_index < l_crates.size(); l_index++ )
+    {
+      for ( uint8_t l_dir = 0; l_dir < 4; l_dir++ )
+      {
+        int16_t  l_offset = g_dir_x[l_dir] + g_dir_y[l_dir] * p_level.width;
+        uint16_t l_from = l_crates[l_index] - l_offset;
+        uint16_t l_to = l_crates[l_index] + l_offset;
+
+        if ( !l_reach[l_from] || !p_level.floor[l_to] || !p_live[l_to] ||
+             std::find( l_crates.begin(), l_crates.end(), l_to ) != l_crates.end() )
+        {
+          continue;
+        }
+        l_successors++;
+
+        /* Make the push, and see if it's somewhere new. */
+        std::vector<uint16_t> l_moved = l_crates;
+        l_moved[l_index] = l_to;
+        std::sort( l_moved.begin(), l_moved.end() );
+
+        std::vector<uint8_t> l_next_reach;
+        reachable( p_level, l_moved, l_crates[l_index], l_next_reach );
+        std::vector<uint16_t> l_next;
+        l_next.push_back( normalise( l_next_reach ) );
+        l_next.insert( l_next.end(), l_moved.begin(), l_moved.end() );
+        if ( l_seen.insert( l_key( l_next ) ).second )
+        {
+          l_states.push_back( l_next );
+          l_depth.push_back( l_depth[l_head] + 1 );
+        }
+      }
+    }
+
+    if ( l_states.size() > LEVELGEN_SOLVE_LIMIT )
+    {
+      return false;
+    }
+  }
+
+  /* Ran out of states without solving it; shouldn't happen! */
+  return false;
+}
+
+
+/*
+ * generate - builds a single candidate level, returning false if it came out
+ *            unusable (too small, too easy, or too hard for us to solve).
+ */
+
+static bool generate( const options_t &p_options, std::mt19937 &p_rng, candidate_t &p_candidate )
+{
+  level_t             &l_level = p_candidate.level;
+  std::vector<uint8_t> l_reach, l_live;
+  std::vector<uint16_t> l_floor;
+
+  /* Start with a room. */
+  l_level.width = p_options.width;
+  l_level.height = p_options.height;
+  carve( l_level, p_rng );
+  for ( uint16_t l_cell = 0; l_cell < l_level.floor.size(); l_cell++ )
+  {
+    if ( l_level.floor[l_cell] )
+    {
+      l_floor.push_back( l_cell );
+    }
+  }
+  if ( l_floor.size() < (size_t)( p_options.crates * 3 + 4 ) )
+  {
+    return false;
+  }
+
+  /* Crates go on the goals, and the player somewhere else. */
+  std::shuffle( l_floor.begin(), l_floor.end(), p_rng );
+  l_level.crates.assign( l_floor.begin(), l_floor.begin() + p_options.crates );
+  for ( uint16_t l_crate : l_level.crates )
+  {
+    l_level.goal[l_crate] = 1;
+  }
+  l_level.player = l_floor[p_options.crates];
+
+  /* Now play it backwards for a while, pulling crates about. */
+  uint16_t l_pulls = 20 + p_rng() % ( 20 * p_options.crates + 1 );
+  for ( uint16_t l_pull = 0; l_pull < l_pulls; l_pull++ )
+  {
+    std::vector<std::pair<uint8_t, uint8_t>> l_options;
+
+    reachable( l_level, l_level.crates, l_level.player, l_reach );
+    for ( uint8_t l_index = 0; l_index < l_level.crates.size(); l_index++ )
+    {
+      for ( uint8_t l_dir = 0; l_dir < 4; l_dir++ )
+      {
+        int16_t  l_offset = g_dir_x[l_dir] + g_dir_y[l_dir] * l_level.width;
+        uint16_t l_stand = l_level.crates[l_index] + l_offset;
+        uint16_t l_back = l_stand + l_offset;
+        if ( l_reach[l_stand] && l_level.floor[l_back] &&
+             std::find( l_level.crates.begin(), l_level.crates.end(), l_back ) == l_level.crates.end() )
+        {
+          l_options.push_back( std::make_pair( l_index, l_dir ) );
+        }
+      }
+    }
+    if ( l_options.empty() )
+    {
+      break;
+    }
+
+    /* Pick one; the crate follows the player back a square. */
+    std::pair<uint8_t, uint8_t> l_choice = l_options[p_rng() % l_options.size()];
+    int16_t l_offset = g_dir_x[l_choice.second] + g_dir_y[l_choice.second] * l_level.width;
+    l_level.crates[l_choice.first] += l_offset;
+    l_level.player = l_level.crates[l_choice.first] + l_offset;
+  }
+  std::sort( l_level.crates.begin(), l_level.crates.end() );
+
+  /* It's no puzzle if the crates are still home. */
+  for ( uint16_t l_crate : l_level.crates )
+  {
+    if ( l_level.goal[l_crate] )
+    {
+      return false;
+    }
+  }
+
+  /* Solve it forwards, to see how hard it really is. */
+  live_cells( l_level, l_live );
+  if ( !solve( l_level, l_live, p_candidate.pushes, p_candidate.branching ) )
+  {
+    return false;
+  }
+  uint16_t l_dead = 0;
+  for ( uint16_t l_cell : l_floor )
+  {
+    l_dead += l_live[l_cell] ? 0 : 1;
+  }
+  p_candidate.deadly = (float)l_dead / l_floor.size();
+
+  /* Longer solutions, more choice and more traps all make it harder. */
+  p_candidate.score = p_candidate.pushes + 2.0f * p_candidate.branching + 10.0f * p_candidate.deadly;
+  return p_candidate.pushes >= p_options.crates * 2;
+}
+
+
+/*
+ * write_level - writes a level out in XSB format; walls which don't touch
+ *               any floor are left out, so the outside is just space.
+ */
+
+static void write_level( FILE *p_file, uint32_t p_number, const candidate_t &p_candidate )
+{
+  const level_t &l_level = p_candidate.level;
+
+  fprintf( p_file, "; %u\n; pushes %u, branching %.2f, deadly %.2f, score %.1f\n\n",
+           (unsigned)p_number, (unsigned)p_candidate.pushes, (double)p_candidate.branching,
+           (double)p_candidate.deadly, (double)p_candidate.score );
+
+  for ( int16_t y = 0; y < l_level.height; y++ )
+  {
+    std::string l_line;
+    for ( int16_t x = 0; x < l_level.width; x++ )
+    {
+      uint16_t l_cell = x + y * l_level.width;
+      bool     l_crate = std::find( l_level.crates.begin(), l_level.crates.end(), l_cell ) != l_level.crates.end();
+
+      if ( !l_level.floor[l_cell] )
+      {
+        /* Only a wall if there's floor next to it. */
+        bool l_wall = false;
+        for ( int8_t l_dy = -1; l_dy <= 1; l_dy++ )
+        {
+          for ( int8_t l_dx = -1; l_dx <= 1; l_dx++ )
+          {
+            int16_t l_nx = x + l_dx, l_ny = y + l_dy;
+            if ( ( l_nx >= 0 ) && ( l_nx < l_level.width ) && ( l_ny >= 0 ) && ( l_ny < l_level.height ) &&
+                 l_level.floor[l_nx + l_ny * l_level.width] )
+            {
+              l_wall = true;
+            }
+          }
+        }
+        l_line += l_wall ? '#' : ' ';
+      }
+      else if ( l_cell == l_level.player )
+      {
+        l_line += l_level.goal[l_cell] ? '+' : '@';
+      }
+      else if ( l_crate )
+      {
+        l_line += l_level.goal[l_cell] ? '*' : '$';
+      }
+      else
+      {
+        l_line += l_level.goal[l_cell] ? '.' : ' ';
+      }
+    }
+
+    /* Trailing space means nothing. */
+    l_line.erase( l_line.find_last_not_of( ' ' ) + 1 );
+    if ( !l_line.empty() )
+    {
+      fprintf( p_file, "%s\n", l_line.c_str() );
+    }
+  }
+  fprintf( p_file, "\n" );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * usage - explains how to drive us.
+ */
+
+static void usage( const char *p_name )
+{
+  fprintf( stderr, "usage: %s [-n levels] [-w width] [-h height] [-c crates] [-s seed]\n"
+                   "          [-j threads] [-t tries per level] [-o output.xsb]\n", p_name );
+  exit( 1 );
+}
+
+
+/*
+ * main - parses the options, sets the workers going and writes out the best
+ *        of what they come up with, easiest first.
+ */
+
+int main( int argc, char **argv )
+{
+  options_t l_options;
+
+  /* Defaults, then whatever we were told. */
+  l_options.width = 12;
+  l_options.height = 10;
+  l_options.crates = 3;
+  l_options.count = 20;
+  l_options.seed = 1;
+  l_options.threads = std::max( 1u, std::thread::hardware_concurrency() );
+  l_options.tries = 20;
+  l_options.output = nullptr;
+
+  for ( int l_arg = 1; l_arg < argc; l_arg++ )
+  {
+    if ( ( l_arg + 1 >= argc ) || ( '-' != argv[l_arg][0] ) )
+    {
+      usage( argv[0] );
+    }
+    uint32_t l_value = strtoul( argv[l_arg + 1], nullptr, 10 );
+    switch( argv[l_arg][1] )
+    {
+      case 'n': l_options.count = l_value; break;
+      case 'w': l_options.width = std::min<uint32_t>( std::max<uint32_t>( l_value, 5 ), LEVELGEN_MAX_W ); break;
+      case 'h': l_options.height = std::min<uint32_t>( std::max<uint32_t>( l_value, 5 ), LEVELGEN_MAX_H ); break;
+      case 'c': l_options.crates = std::min<uint32_t>( std::max<uint32_t>( l_value, 1 ), LEVELGEN_MAX_CRATES ); break;
+      case 's': l_options.seed = l_value; break;
+      case 'j': l_options.threads = std::max<uint32_t>( l_value, 1 ); break;
+      case 't': l_options.tries = std::max<uint32_t>( l_value, 1 ); break;
+      case 'o': l_options.output = argv[l_arg + 1]; break;
+      default:  usage( argv[0] );
+    }
+    l_arg++;
+  }
+
+  /* Each level is the best of a number of tries; the workers take levels */
+  /* off a shared counter, and each level has its own seed so the output  */
+  /* is the same however many threads we use.                             */
+  std::vector<candidate_t>  l_levels( l_options.count );
+  std::vector<uint8_t>      l_found( l_options.count, 0 );
+  std::atomic<uint32_t>     l_next( 0 );
+  std::vector<std::thread>  l_workers;
+
+  for ( uint32_t l_thread = 0; l_thread < l_options.threads; l_thread++ )
+  {
+    l_workers.emplace_back( [&]()
+    {
+      uint32_t l_number;
+      while ( ( l_number = l_next++ ) < l_options.count )
+      {
+        std::mt19937 l_rng( l_options.seed * 7919 + l_number );
+        candidate_t  l_candidate;
+
+        /* Keep going until we've had enough good tries. */
+        for ( uint32_t l_try = 0, l_good = 0; ( l_good < l_options.tries ) && ( l_try < l_options.tries * 50 ); l_try++ )
+        {
+          if ( generate( l_options, l_rng, l_candidate ) )
+          {
+            l_good++;
+            if ( !l_found[l_number] || ( l_candidate.score > l_levels[l_number].score ) )
+            {
+              l_levels[l_number] = l_candidate;
+              l_found[l_number] = 1;
+            }
+          }
+        }
+      }
+    } );
+  }
+  for ( std::thread &l_worker : l_workers )
+  {
+    l_worker.join();
+  }
+
+  /* Keep the ones that worked, easiest first. */
+  std::vector<candidate_t> l_pack;
+  for ( uint32_t l_number = 0; l_number < l_options.count; l_number++ )
+  {
+    if ( l_found[l_number] )
+    {
+      l_pack.push_back( l_levels[l_number] );
+    }
+  }
+  std::stable_sort( l_pack.begin(), l_pack.end(),
+                    []( const candidate_t &a, const candidate_t &b ) { return a.score < b.score; } );
+
+  /* And write them out. */
+  FILE *l_file = l_options.output ? fopen( l_options.output, "w" ) : stdout;
+  if ( nullptr == l_file )
+  {
+    perror( l_options.output );
+    return 1;
+  }
+  fprintf( l_file, "; SokoBlit generated pack, seed %u\n\n", (unsigned)l_options.seed );
+  for ( uint32_t l_index = 0; l_index < l_pack.size(); l_index++ )
+  {
+    write_level( l_file, l_index + 1, l_pack[l_index] );
+  }
+  if ( stdout != l_file )
+  {
+    fclose( l_file );
+  }
+  fprintf( stderr, "levelgen: %u of %u levels generated\n", (unsigned)l_pack.size(), (unsigned)l_options.count );
+
+  /* All done. */
+  return 0;
+}
+
+
+/* End of file levelgen.cpp */
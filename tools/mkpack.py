@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+#
+# mkpack.py - part of SokoBlit
+#
+# Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+#
+# Builds an asset pack for the Linux build to map in at startup, in place of
+# the assets compiled into it. Each asset is named after the array it stands
+# in for (at_game_map, a_font and so on) and can come from:
+#
+#   name=file.tmx   a Tiled map, converted the same way as the asset build
+#   name=file       any other file, taken as it is
+#   file.cpp        every array in one of the sources the asset build writes
+#
+# Later arguments replace earlier ones of the same name, so the usual thing
+# is to start from the build's sources and swap in whatever is being worked
+# on:
+#
+#   mkpack.py -o sokoblit.pak build/assets*.cpp at_game_map=assets/game-map.tmx
+#
+# This software is distributed under the MIT License. See LICENSE for details.
+#
+
+import argparse
+import re
+import struct
+import sys
+import xml.etree.ElementTree as ElementTree
+
+PACK_MAGIC = b"SBPK"
+PACK_VERSION = 1
+PACK_NAME_LEN = 24
+PACK_ALIGN = 4
+
+ARRAY_RE = re.compile(r"(?:const\s+)?uint8_t\s+(\w+)\s*\[\s*\]\s*=\s*\{([^}]*)\}", re.S)
+
+
+def read_tmx(filename, empty):
+    """Flattens every layer of a Tiled map into one byte per tile; Tiled counts
+    tiles from one, with zero for nothing there."""
+    tiles = bytearray()
+    root = ElementTree.parse(filename).getroot()
+    for layer in root.iter("layer"):
+        data = layer.find("data")
+        if data is None or data.get("encoding") != "csv":
+            sys.exit(f"{filename}: only CSV encoded layers are supported")
+        for gid in data.text.replace("\n", "").split(","):
+            gid = int(gid)
+            tiles.append(empty if gid == 0 else (gid - 1) & 0xFF)
+    return bytes(tiles)
+
+
+def read_source(filename):
+    """Pulls every uint8_t array out of a generated asset source."""
+    with open(filename) as source:
+        text = source.read()
+    assets = {}
+    for name, body in ARRAY_RE.findall(text):
+        values = [v for v in body.replace("\n", "").split(",") if v.strip()]
+        assets[name] = bytes(int(v, 0) for v in values)
+    if not assets:
+        sys.exit(f"{filename}: no asset arrays found")
+    return assets
+
+
+def write_pack(filename, assets):
+    """Writes the header, the directory and then the assets, each starting on
+    a four byte boundary so the game can use them where they are."""
+    header_size = 12 + len(assets) * (PACK_NAME_LEN + 8)
+    offset = (header_size + PACK_ALIGN - 1) & ~(PACK_ALIGN - 1)
+    directory = bytearray(struct.pack("<4sII", PACK_MAGIC, PACK_VERSION, len(assets)))
+    body = bytearray()
+    for name, data in assets.items():
+        directory += struct.pack(f"<{PACK_NAME_LEN}sII", name.encode(), offset + len(body), len(data))
+        body += data
+        body += bytes(-len(body) % PACK_ALIGN)
+    directory += bytes(offset - len(directory))
+    with open(filename, "wb") as pack:
+        pack.write(directory + body)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build a SokoBlit asset pack.")
+    parser.add_argument("-o", "--output", default="sokoblit.pak", help="pack file to write")
+    parser.add_argument("--empty", type=int, default=0, help="tile for empty map cells")
+    parser.add_argument("assets", nargs="+", help="name=file, or a generated asset source")
+    args = parser.parse_args()
+
+    assets = {}
+    for asset in args.assets:
+        if "=" in asset:
+            name, filename = asset.split("=", 1)
+            if filename.endswith(".tmx"):
+                assets[name] = read_tmx(filename, args.empty)
+            else:
+                with open(filename, "rb") as source:
+                    assets[name] = source.read()
+        else:
+            assets.update(read_source(asset))
+
+    for name in assets:
+        if len(name.encode()) >= PACK_NAME_LEN:
+            sys.exit(f"{name}: asset names must be under {PACK_NAME_LEN} characters")
+
+    write_pack(args.output, assets)
+    for name, data in assets.items():
+        print(f"  {name:<{PACK_NAME_LEN}} {len(data):8}")
+    print(f"{args.output}: {len(assets)} assets")
+
+
+if __name__ == "__main__":
+    main()
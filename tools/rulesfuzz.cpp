@@ -0,0 +1,562 @@
+/*
+ * rulesfuzz.cpp - part of SokoBlit
+ *
+ * Copyright (c) 2021 Pete Favelle / fsqaured limited <32blit@fsquared.co.uk>
+ *
+ * Host-only differential tester for the move rules. Random levels are built
+ * as tile maps the way the Tiled map lays them out, and random sequences of
+ * moves are played through the game's own rules (Rules.cpp, driven the same
+ * way that Game::update drives them) and through a plain reference model of
+ * Sokoban side by side. The game side holds one metatile per cell, as the
+ * game does, and the tiles are compared after every move; the cells a move
+ * touched straight away, and the whole level at the end of each sequence.
+ *
+ * Any disagreement is cut down to the shortest sequence of moves we can find
+ * that still shows it, and printed as the level and a move string.
+ *
+ * This software is distributed under the MIT License. See LICENSE for details.
+ */
+
+
+/* System headers. */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Local headers. */
+
+#include "Metatile.hpp"
+#include "Rules.hpp"
+
+
+/* Constants. */
+
+#define RULESFUZZ_MAX_W       20      /* the biggest level the game can show */
+#define RULESFUZZ_MAX_H       15
+
+static const direction_t g_directions[4] = { DIR_DOWN, DIR_LEFT, DIR_UP, DIR_RIGHT };
+static const char        g_move_names[] = "?dlur";
+
+/* Floor tiles which are neither walls, crates nor goals, for variety. */
+static const uint8_t     g_floors[] = { TILED_EMPTY, TILED_EMPTY, 6, 8, 38 };
+
+
+/* Types. */
+
+typedef struct
+{
+  uint8_t                 width;
+  uint8_t                 height;
+  uint32_t                boards;
+  uint32_t                sequences;
+  uint32_t                length;
+  uint32_t                seed;
+  uint32_t                threads;
+} options_t;
+
+/* A level, as the map would hold it, plus the same thing as cells. */
+
+typedef struct
+{
+  uint8_t                 width;
+  uint8_t                 height;
+  std::vector<uint8_t>    tiles;      /* 2x2 tiles per cell, as in the map */
+  std::vector<char>       cells;      /* '#', ' ', '.' or '$' */
+  std::vector<uint8_t>    floor;      /* the block under each cell, for the reference */
+  uint16_t                player;
+  MetatileSet             metatiles;  /* every block in the level */
+  std::vector<uint8_t>    start;      /* the metatile of each cell, to start */
+} board_t;
+
+/* The game side; metatiles driven through the rules, as Game does. */
+
+typedef struct
+{
+  const board_t          *board;
+  MetatileSet             metatiles;
+  std::vector<uint8_t>    cells;
+  int16_t                 x;          /* the player, in tiles */
+  int16_t                 y;
+} gamestate_t;
+
+/* The reference side; plain cells. */
+
+typedef struct
+{
+  std::vector<uint8_t>    crate;
+  uint16_t                player;
+} refstate_t;
+
+
+/* Functions. */
+
+/*
+ * make_board - builds a random walled level; inside, it's a scatter of walls,
+ *              goals and crates. The map has no tile for a crate already on
+ *              a goal, so we never start with one.
+ */
+
+static void make_board( const options_t &p_options, std::mt19937 &p_rng, board_t &p_board )
+{
+  uint16_t l_tiles_w = p_options.width * RULES_CELL;
+
+  p_board.width = p_options.width;
+  p_board.height = p_options.height;
+  p_board.cells.assign( p_board.width * p_board.height, ' ' );
+  p_board.tiles.assign( l_tiles_w * p_board.height * RULES_CELL, 0 );
+
+  /* Lay out the cells first. */
+  std::vector<uint16_t> l_floor;
+  for ( uint8_t y = 0; y < p_board.height; y++ )
+  {
+    for ( uint8_t x = 0; x < p_board.width; x++ )
+    {
+      uint16_t l_cell = y * p_board.width + x;
+      if ( ( 0 == x ) || ( 0 == y ) || ( p_board.width - 1 == x ) || ( p_board.height - 1 == y ) ||
+           ( p_rng() % 100 < 15 ) )
+      {
+        p_board.cells[l_cell] = '#';
+      }
+      else
+      {
+        l_floor.push_back( l_cell );
+      }
+    }
+  }
+  std::shuffle( l_floor.begin(), l_floor.end(), p_rng );
+
+  /* One cell for the player, and then goals and crates from the rest. */
+  uint16_t l_crates = std::min<size_t>( 1 + p_rng() % 6, ( l_floor.size() - 1 ) / 2 );
+  p_board.player = l_floor[0];
+  for ( uint16_t l_index = 0; l_index < l_crates; l_index++ )
+  {
+    p_board.cells[l_floor[1 + l_index]] = '.';
+    p_board.cells[l_floor[1 + l_crates + l_index]] = '$';
+  }
+
+  /* And then the tiles the map would have for them; the reference keeps */
+  /* its own note of the floor under each one, which for a crate is bare  */
+  /* floor - that's what it's standing on.                                */
+  p_board.floor.assign( p_board.cells.size(), TILED_EMPTY );
+  for ( uint16_t l_cell = 0; l_cell < p_board.cells.size(); l_cell++ )
+  {
+    uint8_t l_type;
+    switch( p_board.cells[l_cell] )
+    {
+      case '#': l_type = TILED_WALL; p_board.floor[l_cell] = l_type; break;
+      case '.': l_type = TILED_CRATE_HOME; p_board.floor[l_cell] = l_type; break;
+      case '$': l_type = TILED_CRATE; break;
+      default:  l_type = ( l_cell == p_board.player ) ? TILED_PLAYER_HOME : g_floors[p_rng() % sizeof( g_floors )];
+                p_board.floor[l_cell] = l_type; break;
+    }
+    uint8_t *l_tile = &p_board.tiles[( l_cell / p_board.width ) * RULES_CELL * l_tiles_w +
+                                     ( l_cell % p_board.width ) * RULES_CELL];
+    l_tile[0] = l_type;
+    l_tile[1] = l_type + 1;
+    l_tile[l_tiles_w] = l_type + 16;
+    l_tile[l_tiles_w + 1] = l_type + 17;
+  }
+
+  /* Which then go into the metatiles, the way Game loads a level. */
+  p_board.metatiles = MetatileSet();
+  p_board.metatiles.add( TILED_CRATE );
+  p_board.metatiles.add( TILED_EMPTY );
+  p_board.start.assign( p_board.cells.size(), 0 );
+  for ( uint16_t l_cell = 0; l_cell < p_board.cells.size(); l_cell++ )
+  {
+    p_board.start[l_cell] = p_board.metatiles.add( &p_board.tiles[( l_cell / p_board.width ) * RULES_CELL * l_tiles_w +
+                                                                  ( l_cell % p_board.width ) * RULES_CELL ], l_tiles_w );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * game_tile - returns a tile from the game side; off the level is blank, as
+ *             it is off the map.
+ */
+
+static uint8_t game_tile( gamestate_t &p_game, int16_t p_x, int16_t p_y )
+{
+  uint16_t l_tiles_w = p_game.board->width * RULES_CELL;
+
+  if ( ( p_x < 0 ) || ( p_y < 0 ) || ( p_x >= l_tiles_w ) || ( p_y >= p_game.board->height * RULES_CELL ) )
+  {
+    return 0;
+  }
+  return p_game.metatiles.tile( p_game.cells[( p_y / RULES_CELL ) * p_game.board->width + ( p_x / RULES_CELL )],
+                                ( p_x % RULES_CELL ) + ( p_y % RULES_CELL ) * RULES_CELL );
+}
+
+
+/*
+ * game_set - the game's set_tile, without the crate bits; the rules decide
+ *            what the cell becomes, and going back to the original looks up
+ *            the block the map has there.
+ */
+
+static void game_set( gamestate_t &p_game, int16_t p_x, int16_t p_y, uint8_t p_type )
+{
+  uint16_t       l_tiles_w = p_game.board->width * RULES_CELL;
+  const uint8_t *l_original = &p_game.board->tiles[p_y * l_tiles_w + p_x];
+  uint8_t        l_type = rules_cell( l_original[0], p_type );
+  int16_t        l_id;
+
+  l_id = ( TILED_RESET == l_type ) ? p_game.metatiles.find( l_original, l_tiles_w ) : p_game.metatiles.find( l_type );
+  if ( l_id >= 0 )
+  {
+    p_game.cells[( p_y / RULES_CELL ) * p_game.board->width + ( p_x / RULES_CELL )] = l_id;
+  }
+  return;
+}
+
+
+/*
+ * game_move - one move on the game side, in the order Game::update makes it;
+ *             the pushed crate is lifted as the move starts and parked once
+ *             the player has arrived. The player's own sanity check on the
+ *             edges of the level is kept, too.
+ */
+
+static void game_move( gamestate_t &p_game, direction_t p_direction )
+{
+  int8_t l_dx, l_dy;
+  bool   l_pushing = false;
+
+  rules_step( p_direction, &l_dx, &l_dy );
+  switch( rules_check( game_tile( p_game, p_game.x + l_dx, p_game.y + l_dy ),
+                       game_tile( p_game, p_game.x + l_dx * 2, p_game.y + l_dy * 2 ) ) )
+  {
+    case RULE_BLOCKED:
+      return;
+    case RULE_PUSH:
+      game_set( p_game, p_game.x + l_dx, p_game.y + l_dy, TILED_RESET );
+      l_pushing = true;
+      break;
+    case RULE_WALK:
+      break;
+  }
+
+  /* Player::move only moves within the 40x30 tiles of a level. */
+  int16_t l_x = p_game.x + l_dx, l_y = p_game.y + l_dy;
+  if ( ( l_x >= 0 ) && ( l_x < 40 ) && ( l_y >= 0 ) && ( l_y < 30 ) )
+  {
+    p_game.x = l_x;
+    p_game.y = l_y;
+  }
+
+  /* And the crate arrives one cell ahead of the player. */
+  if ( l_pushing )
+  {
+    game_set( p_game, p_game.x + l_dx, p_game.y + l_dy, TILED_CRATE );
+  }
+  return;
+}
+
+
+/*
+ * ref_move - one move on the reference side, by the book.
+ */
+
+static void ref_move( const board_t &p_board, refstate_t &p_ref, direction_t p_direction )
+{
+  int8_t  l_dx, l_dy;
+  rules_step( p_direction, &l_dx, &l_dy );
+
+  int16_t  l_step = ( l_dy / RULES_CELL ) * p_board.width + ( l_dx / RULES_CELL );
+  uint16_t l_target = p_ref.player + l_step;
+  uint16_t l_beyond = l_target + l_step;
+
+  if ( '#' == p_board.cells[l_target] )
+  {
+    return;
+  }
+  if ( p_ref.crate[l_target] )
+  {
+    if ( ( '#' == p_board.cells[l_beyond] ) || p_ref.crate[l_beyond] )
+    {
+      return;
+    }
+    p_ref.crate[l_target] = 0;
+    p_ref.crate[l_beyond] = 1;
+  }
+  p_ref.player = l_target;
+  return;
+}
+
+
+/*
+ * check_cell - compares one cell of the game side against what the reference
+ *              says should be there; returns true if they agree.
+ */
+
+static bool check_cell( gamestate_t &p_game, const refstate_t &p_ref, uint16_t p_cell )
+{
+  /* A crate is always a crate; otherwise it's the floor the reference */
+  /* noted under the cell when the board was built.                    */
+  uint8_t l_type = p_ref.crate[p_cell] ? TILED_CRATE : p_game.board->floor[p_cell];
+  uint8_t l_expect[4] = { l_type, (uint8_t)( l_type + 1 ), (uint8_t)( l_type + 16 ), (uint8_t)( l_type + 17 ) };
+
+  uint8_t l_id = p_game.cells[p_cell];
+  return ( p_game.metatiles.tile( l_id, 0 ) == l_expect[0] ) && ( p_game.metatiles.tile( l_id, 1 ) == l_expect[1] ) &&
+         ( p_game.metatiles.tile( l_id, 2 ) == l_expect[2] ) && ( p_game.metatiles.tile( l_id, 3 ) == l_expect[3] );
+}
+
+
+/*
+ * check_player - compares where the two sides think the player is.
+ */
+
+static bool check_player( const gamestate_t &p_game, const refstate_t &p_ref )
+{
+  return ( p_game.x == ( p_ref.player % p_game.board->width ) * RULES_CELL ) &&
+         ( p_game.y == ( p_ref.player / p_game.board->width ) * RULES_CELL );
+}
+
+
+/*
+ * run - plays a sequence of moves through both sides, returning the index of
+ *       the move after which they first disagree, or -1 if they never do.
+ */
+
+static int32_t run( const board_t &p_board, const std::vector<direction_t> &p_moves )
+{
+  gamestate_t l_game;
+  refstate_t  l_ref;
+
+  l_game.board = &p_board;
+  l_game.metatiles = p_board.metatiles;
+  l_game.cells = p_board.start;
+  l_game.x = ( p_board.player % p_board.width ) * RULES_CELL;
+  l_game.y = ( p_board.player / p_board.width ) * RULES_CELL;
+  l_ref.player = p_board.player;
+  l_ref.crate.assign( p_board.cells.size(), 0 );
+  for ( uint16_t l_cell = 0; l_cell < p_board.cells.size(); l_cell++ )
+  {
+    l_ref.crate[l_cell] = ( '$' == p_board.cells[l_cell] );
+  }
+
+  for ( uint32_t l_index = 0; l_index < p_moves.size(); l_index++ )
+  {
+    int8_t   l_dx, l_dy;
+    uint16_t l_before = l_ref.player;
+
+    game_move( l_game, p_moves[l_index] );
+    ref_move( p_board, l_ref, p_moves[l_index] );
+
+    /* A move can only touch the player's cell and the two ahead of it. */
+    rules_step( p_moves[l_index], &l_dx, &l_dy );
+    int16_t l_step = ( l_dy / RULES_CELL ) * p_board.width + ( l_dx / RULES_CELL );
+    if ( !check_player( l_game, l_ref ) || !check_cell( l_game, l_ref, l_before ) ||
+         !check_cell( l_game, l_ref, l_before + l_step ) ||
+         ( ( l_before + l_step * 2 >= 0 ) && ( l_before + l_step * 2 < (int32_t)p_board.cells.size() ) &&
+           !check_cell( l_game, l_ref, l_before + l_step * 2 ) ) )
+    {
+      return l_index;
+    }
+  }
+
+  /* And then the whole level, in case something strayed. */
+  for ( uint16_t l_cell = 0; l_cell < p_board.cells.size(); l_cell++ )
+  {
+    if ( !check_cell( l_game, l_ref, l_cell ) )
+    {
+      return p_moves.size() - 1;
+    }
+  }
+  return -1;
+}
+
+
+/*
+ * minimise - cuts a failing sequence down, dropping runs of moves (halving
+ *            the run each time round) for as long as it still fails.
+ */
+
+static void minimise( const board_t &p_board, std::vector<direction_t> &p_moves )
+{
+  /* Nothing after the failure matters. */
+  p_moves.resize( run( p_board, p_moves ) + 1 );
+
+  for ( size_t l_chunk = std::max<size_t>( p_moves.size() / 2, 1 ); l_chunk > 0; l_chunk /= 2 )
+  {
+    for ( size_t l_start = 0; l_start + l_chunk <= p_moves.size(); )
+    {
+      std::vector<direction_t> l_shorter( p_moves );
+      l_shorter.erase( l_shorter.begin() + l_start, l_shorter.begin() + l_start + l_chunk );
+      int32_t l_failed = l_shorter.empty() ? -1 : run( p_board, l_shorter );
+      if ( l_failed >= 0 )
+      {
+        l_shorter.resize( l_failed + 1 );
+        p_moves = l_shorter;
+      }
+      else
+      {
+        l_start++;
+      }
+    }
+  }
+  return;
+}
+
+
+/*
+ * report - prints the level and the moves that break it.
+ */
+
+static void report( uint32_t p_number, const board_t &p_board, const std::vector<direction_t> &p_moves )
+{
+  printf( "; board %u\n", (unsigned)p_number );
+  for ( uint8_t y = 0; y < p_board.height; y++ )
+  {
+    for ( uint8_t x = 0; x < p_board.width; x++ )
+    {
+      uint16_t l_cell = y * p_board.width + x;
+      putchar( ( l_cell == p_board.player ) ? '@' : p_board.cells[l_cell] );
+    }
+    putchar( '\n' );
+  }
+
+  printf( "moves (%u): ", (unsigned)p_moves.size() );
+  for ( direction_t l_move : p_moves )
+  {
+    putchar( g_move_names[l_move] );
+  }
+  putchar( '\n' );
+  return;
+}
+
+
+/*
+ * usage - explains how to drive us.
+ */
+
+static void usage( const char *p_name )
+{
+  fprintf( stderr, "usage: %s [-b boards] [-n sequences per board] [-l moves per sequence]\n"
+                   "          [-w width] [-h height] [-s seed] [-j threads]\n", p_name );
+  exit( 1 );
+}
+
+
+/*
+ * main - parses the options, and sets the workers going; each takes boards
+ *        off a shared counter, and each board has its own seed, so that any
+ *        failure we report is the same however many threads we use.
+ */
+
+int main( int argc, char **argv )
+{
+  options_t l_options;
+
+  /* Defaults, then whatever we were told. */
+  l_options.width = 12;
+  l_options.height = 10;
+  l_options.boards = 1000;
+  l_options.sequences = 1000;
+  l_options.length = 64;
+  l_options.seed = 1;
+  l_options.threads = std::max( 1u, std::thread::hardware_concurrency() );
+
+  for ( int l_arg = 1; l_arg < argc; l_arg++ )
+  {
+    if ( ( l_arg + 1 >= argc ) || ( '-' != argv[l_arg][0] ) )
+    {
+      usage( argv[0] );
+    }
+    uint32_t l_value = strtoul( argv[l_arg + 1], nullptr, 10 );
+    switch( argv[l_arg][1] )
+    {
+      case 'b': l_options.boards = std::max<uint32_t>( l_value, 1 ); break;
+      case 'n': l_options.sequences = std::max<uint32_t>( l_value, 1 ); break;
+      case 'l': l_options.length = std::max<uint32_t>( l_value, 1 ); break;
+      case 'w': l_options.width = std::min<uint32_t>( std::max<uint32_t>( l_value, 3 ), RULESFUZZ_MAX_W ); break;
+      case 'h': l_options.height = std::min<uint32_t>( std::max<uint32_t>( l_value, 3 ), RULESFUZZ_MAX_H ); break;
+      case 's': l_options.seed = l_value; break;
+      case 'j': l_options.threads = std::max<uint32_t>( l_value, 1 ); break;
+      default:  usage( argv[0] );
+    }
+    l_arg++;
+  }
+
+  std::atomic<uint32_t>     l_next( 0 );
+  std::atomic<uint32_t>     l_failed( UINT32_MAX );
+  std::mutex                l_lock;
+  board_t                   l_failed_board;
+  std::vector<direction_t>  l_failed_moves;
+  std::atomic<uint64_t>     l_moves( 0 );
+  std::vector<std::thread>  l_workers;
+  auto                      l_start = std::chrono::steady_clock::now();
+
+  for ( uint32_t l_thread = 0; l_thread < l_options.threads; l_thread++ )
+  {
+    l_workers.emplace_back( [&]()
+    {
+      std::vector<direction_t> l_sequence( l_options.length );
+      uint32_t                 l_number;
+
+      /* Any board after one that's already failed is no use to us. */
+      while ( ( ( l_number = l_next++ ) < l_options.boards ) && ( l_number < l_failed ) )
+      {
+        std::mt19937 l_rng( l_options.seed * 7919 + l_number );
+        board_t      l_board;
+
+        make_board( l_options, l_rng, l_board );
+        for ( uint32_t l_run = 0; l_run < l_options.sequences; l_run++ )
+        {
+          for ( direction_t &l_move : l_sequence )
+          {
+            l_move = g_directions[l_rng() & 3];
+          }
+          l_moves += l_options.length;
+          if ( run( l_board, l_sequence ) < 0 )
+          {
+            continue;
+          }
+
+          /* Keep the lowest numbered failure, so the report is repeatable. */
+          std::lock_guard<std::mutex> l_guard( l_lock );
+          if ( l_number < l_failed )
+          {
+            l_failed = l_number;
+            l_failed_board = l_board;
+            l_failed_moves = l_sequence;
+          }
+          break;
+        }
+      }
+    } );
+  }
+  for ( std::thread &l_worker : l_workers )
+  {
+    l_worker.join();
+  }
+
+  /* And say how it went; any failure is cut down to size first. */
+  if ( UINT32_MAX != l_failed )
+  {
+    minimise( l_failed_board, l_failed_moves );
+    report( l_failed, l_failed_board, l_failed_moves );
+  }
+  double l_seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - l_start ).count();
+  fprintf( stderr, "rulesfuzz: %llu moves in %.2fs (%.1fM moves/s, %.0fk sequences/s): %s\n",
+           (unsigned long long)l_moves, l_seconds, l_moves / l_seconds / 1e6,
+           l_moves / l_options.length / l_seconds / 1e3,
+           ( UINT32_MAX == l_failed ) ? "all agree" : "DISAGREEMENT" );
+  return ( UINT32_MAX == l_failed ) ? 0 : 1;
+}
+
+
+/* End of file rulesfuzz.cpp */